@@ -0,0 +1,82 @@
+"""Microbenchmark of CommandMessagesChecker acknowledgement patterns
+
+Adds a burst of commands and acknowledges them in order, in reversed order and in random order,
+prints mean time per acknowledgement. Run from repository root:
+
+    python3 benchmarks/command_messages_checker_benchmark.py [burst sizes...]
+"""
+
+import logging
+import os
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+from external_server.checker.command_messages_checker import CommandMessagesChecker
+
+
+TIMEOUT = 60
+REPEATS = 5
+
+
+def _in_order(count: int) -> list[int]:
+    return list(range(count))
+
+
+def _reversed(count: int) -> list[int]:
+    return list(reversed(range(count)))
+
+
+def _random(count: int) -> list[int]:
+    acks = list(range(count))
+    random.Random(count).shuffle(acks)
+    return acks
+
+
+PATTERNS = {"in order": _in_order, "reversed": _reversed, "random": _random}
+
+
+def _command() -> external_protocol.Command:
+    command = external_protocol.Command()
+    command.deviceCommand.device.module = 1
+    command.deviceCommand.device.deviceType = 0
+    command.deviceCommand.device.deviceRole = "benchmark"
+    return command
+
+
+def benchmark(count: int, acks: list[int]) -> float:
+    """Returns the best mean time in seconds of one pop_commands call over REPEATS runs."""
+    best = float("inf")
+    command = _command()
+    for _ in range(REPEATS):
+        checker = CommandMessagesChecker(TIMEOUT)
+        for _ in range(count):
+            checker.add_command(command, True)
+        first_counter = checker.counter - count
+        start = time.perf_counter()
+        popped = 0
+        for ack in acks:
+            popped += len(checker.pop_commands(first_counter + ack))
+        elapsed = time.perf_counter() - start
+        assert popped == count
+        checker.reset()
+        best = min(best, elapsed / count)
+    return best
+
+
+def main() -> None:
+    counts = [int(arg) for arg in sys.argv[1:]] or [100, 1000, 10000]
+    # Out of order acknowledgements are logged as warnings, logging would dominate the results
+    logging.disable(logging.CRITICAL)
+    print(f"{'commands':>10} {'pattern':>10} {'us per ack':>12}")
+    for count in counts:
+        for name, pattern in PATTERNS.items():
+            print(f"{count:>10} {name:>10} {benchmark(count, pattern(count)) * 1e6:>12.2f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,242 @@
+"""Load test of External server with simulated module gateway
+
+Runs the connect sequence of a simulated car, then sends statuses of all devices at each of the
+given rates and reports latencies, the highest sustainable status rate and reconnect time. With
+--module-lib, External server is started with the stub module (see benchmarks/stub_module) and
+per-stage latencies are computed from its metrics. Without it, a running External server is
+tested and per-stage latencies are reported if --metrics-port matches its metrics_port.
+With --unix-socket, the simulated gateway connects to the Unix socket transport of External
+server and no broker is needed. Run from repository root against a running MQTT broker, e.g.:
+
+    python3 benchmarks/load_test.py --module-lib benchmarks/stub_module/libstub_module.so --devices 20
+"""
+
+import argparse
+import json
+import os
+import re
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import InternalProtocol_pb2 as internal_protocol
+from simulated_module_gateway import SimulatedModuleGateway
+
+
+# Server histograms reported per stage, (metric name, required labels)
+STAGES = {
+    "queue + handling": ("external_server_status_latency_seconds", {}),
+    "status handling": ("external_server_status_handling_seconds", {}),
+    "forward_status": ("external_server_module_call_seconds", {"function": "forward_status"}),
+    "forward_status_batch": ("external_server_module_call_seconds", {"function": "forward_status_batch"}),
+    "command dispatch": ("external_server_command_dispatch_seconds", {}),
+    "command round trip": ("external_server_command_round_trip_seconds", {}),
+}
+
+_BUCKET_LINE = re.compile(r'^(\w+)_bucket\{(.*)\} (\S+)$')
+_LABEL = re.compile(r'(\w+)="([^"]*)"')
+
+
+def _percentile(values: list[float], q: float) -> float:
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def _scrape(metrics_url: str | None) -> dict[str, list[tuple[dict[str, str], float, float]]]:
+    """Returns histogram buckets by metric name as (labels without le, le, cumulative count)."""
+    if metrics_url is None:
+        return {}
+    try:
+        with urllib.request.urlopen(metrics_url, timeout=5) as response:
+            text = response.read().decode("utf-8")
+    except OSError:
+        return {}
+    buckets: dict[str, list[tuple[dict[str, str], float, float]]] = {}
+    for line in text.splitlines():
+        match = _BUCKET_LINE.match(line)
+        if match is None:
+            continue
+        name, labels_text, count = match.groups()
+        labels = dict(_LABEL.findall(labels_text))
+        le = labels.pop("le")
+        buckets.setdefault(name, []).append((labels, float("inf") if le == "+Inf" else float(le), float(count)))
+    return buckets
+
+
+def _stage_quantiles(before: dict, after: dict, name: str, required: dict[str, str]) -> tuple[int, float, float]:
+    """Returns number of observations, p50 and p99 of histogram observed between two scrapes."""
+    counts: dict[float, float] = {}
+    for snapshot, sign in ((after, 1), (before, -1)):
+        for labels, le, count in snapshot.get(name, []):
+            if all(labels.get(key) == value for key, value in required.items()):
+                counts[le] = counts.get(le, 0) + sign * count
+    bounds = sorted(counts)
+    total = counts.get(float("inf"), 0)
+    if total <= 0:
+        return 0, float("nan"), float("nan")
+
+    def quantile(q: float) -> float:
+        for bound in bounds:
+            if counts[bound] >= q * total:
+                return bound
+        return float("inf")
+
+    return int(total), quantile(0.5), quantile(0.99)
+
+
+def _start_server(args: argparse.Namespace, directory: str) -> subprocess.Popen:
+    config = {
+        "company_name": args.company,
+        "car_name": args.car,
+        "mqtt_address": args.broker_address,
+        "mqtt_port": args.broker_port,
+        "mqtt_timeout": 10,
+        "timeout": 10,
+        "send_invalid_command": False,
+        "sleep_duration_after_connection_refused": 0.5,
+        "log_files_directory": "",
+        "log_files_to_keep": 0,
+        "log_file_max_size_bytes": 0,
+        "metrics_port": args.metrics_port,
+        "transport": "unix_socket" if args.unix_socket else "mqtt",
+        "unix_socket_path": args.unix_socket,
+        "modules": {
+            str(args.module): {
+                "lib_path": os.path.abspath(args.module_lib),
+                "config": {"commands_per_status": str(args.commands_per_status)},
+            }
+        },
+    }
+    config_path = os.path.join(directory, "config.json")
+    with open(config_path, "w") as config_file:
+        json.dump(config, config_file)
+    log_file = open(os.path.join(directory, "external_server.log"), "w")
+    server = subprocess.Popen(
+        [sys.executable, "external_server_main.py", "-c", config_path], stdout=log_file, stderr=subprocess.STDOUT
+    )
+    deadline = time.monotonic() + 10
+    while not _scrape(f"http://127.0.0.1:{args.metrics_port}/metrics") and time.monotonic() < deadline:
+        if server.poll() is not None:
+            raise RuntimeError(f"External server exited, see {log_file.name}")
+        time.sleep(0.1)
+    return server
+
+
+def _run_rate(gateway: SimulatedModuleGateway, devices: list, rate: float, duration: float) -> tuple[int, float]:
+    """Sends statuses of devices in turns at given rate, returns number of sent statuses and achieved rate."""
+    interval = 1 / rate
+    start = time.monotonic()
+    next_send = start
+    sent = 0
+    while next_send < start + duration:
+        now = time.monotonic()
+        if now < next_send:
+            time.sleep(next_send - now)
+        gateway.send_status(devices[sent % len(devices)])
+        sent += 1
+        next_send += interval
+    return sent, sent / (time.monotonic() - start)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--broker-address", default="127.0.0.1")
+    parser.add_argument("--broker-port", type=int, default=1883)
+    parser.add_argument("--company", default="load_test")
+    parser.add_argument("--car", default="car_1")
+    parser.add_argument("--devices", type=int, default=10, help="number of simulated devices")
+    parser.add_argument("--module", type=int, default=1, help="module number of the devices")
+    parser.add_argument("--status-size", type=int, default=64, help="size of status data in bytes")
+    parser.add_argument(
+        "--rates", type=float, nargs="+", default=[50, 100, 200, 400, 800, 1600],
+        help="status rates of all devices together in statuses per second, tested in given order",
+    )
+    parser.add_argument("--duration", type=float, default=10, help="duration of every rate in seconds")
+    parser.add_argument(
+        "--max-p99", type=float, default=0.1, help="highest status response p99 latency of sustainable rate in seconds"
+    )
+    parser.add_argument("--reconnects", type=int, default=3, help="number of measured reconnections")
+    parser.add_argument("--module-lib", help="start External server with this module library")
+    parser.add_argument("--commands-per-status", type=int, default=1, help="stub module config, with --module-lib")
+    parser.add_argument("--metrics-port", type=int, default=9100, help="metrics_port of External server")
+    parser.add_argument("--unix-socket", help="connect to this Unix socket of External server instead of MQTT broker")
+    args = parser.parse_args()
+
+    directory = tempfile.mkdtemp(prefix="external_server_load_test_")
+    server = _start_server(args, directory) if args.module_lib else None
+    metrics_url = f"http://127.0.0.1:{args.metrics_port}/metrics"
+    devices = [
+        internal_protocol.Device(
+            module=args.module, deviceType=0, deviceRole=f"device_{i}", deviceName=f"Device {i}", priority=0
+        )
+        for i in range(args.devices)
+    ]
+    gateway = SimulatedModuleGateway(args.company, args.car, devices, args.status_size, args.unix_socket)
+    try:
+        gateway.start(args.broker_address, args.broker_port)
+        print(f"Connect sequence of {args.devices} devices: {gateway.connect() * 1000:.1f} ms")
+        gateway.take_latencies()
+
+        sustainable_rate = None
+        for rate in args.rates:
+            before = _scrape(metrics_url)
+            sent, achieved_rate = _run_rate(gateway, devices, rate, args.duration)
+            responded = gateway.wait_for_status_responses(max(2.0, args.max_p99 * 10))
+            after = _scrape(metrics_url)
+            status_latencies, command_latencies = gateway.take_latencies()
+            p99 = _percentile(status_latencies, 0.99)
+            sustainable = responded and p99 <= args.max_p99 and achieved_rate >= 0.95 * rate
+
+            print(f"\nRate {rate:g}/s: sent {sent} statuses at {achieved_rate:.0f}/s, "
+                  f"{len(status_latencies)} responded, {'sustained' if sustainable else 'NOT sustained'}")
+            if achieved_rate < 0.95 * rate:
+                print("  simulated gateway could not send at the requested rate")
+            print(f"  {'stage':<22} {'count':>8} {'p50 ms':>10} {'p99 ms':>10}")
+            print(f"  {'status response':<22} {len(status_latencies):>8} "
+                  f"{_percentile(status_latencies, 0.5) * 1000:>10.3f} {p99 * 1000:>10.3f}")
+            print(f"  {'status to command':<22} {len(command_latencies):>8} "
+                  f"{_percentile(command_latencies, 0.5) * 1000:>10.3f} {_percentile(command_latencies, 0.99) * 1000:>10.3f}")
+            for stage, (name, labels) in STAGES.items():
+                count, p50, stage_p99 = _stage_quantiles(before, after, name, labels)
+                if count:
+                    print(f"  {stage:<22} {count:>8} {p50 * 1000:>10.3f} {stage_p99 * 1000:>10.3f}")
+
+            if not sustainable:
+                break
+            sustainable_rate = rate
+        print(f"\nMax sustainable status rate: {sustainable_rate if sustainable_rate is not None else 'none'}/s")
+
+        if not gateway.wait_for_status_responses(30):
+            print("Statuses of the last rate have not been responded, skipping reconnections")
+            return
+        reconnect_times = []
+        for _ in range(args.reconnects):
+            start = time.monotonic()
+            gateway.disconnect()
+            gateway.connect()
+            reconnect_times.append(time.monotonic() - start)
+        if reconnect_times:
+            print(f"Reconnect time (disconnect of all devices to finished connect sequence): "
+                  f"mean {sum(reconnect_times) / len(reconnect_times) * 1000:.1f} ms, "
+                  f"max {max(reconnect_times) * 1000:.1f} ms")
+    finally:
+        gateway.stop()
+        if server is not None:
+            server.send_signal(signal.SIGINT)
+            try:
+                server.wait(10)
+            except subprocess.TimeoutExpired:
+                server.kill()
+            print(f"External server log: {os.path.join(directory, 'external_server.log')}")
+
+
+if __name__ == "__main__":
+    main()
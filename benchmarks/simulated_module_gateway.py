@@ -0,0 +1,284 @@
+import random
+import socket
+import string
+import struct
+import sys
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+from paho.mqtt.enums import CallbackAPIVersion
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+import InternalProtocol_pb2 as internal_protocol
+
+
+QOS = 1
+# Status data starts with monotonic time of sending in ns, stub module copies it to command
+_TIMESTAMP = struct.Struct(">Q")
+# Messages on Unix socket are prefixed by their length
+_LENGTH = struct.Struct("<I")
+
+
+class SimulatedModuleGateway:
+    """
+    Module gateway of one car simulated for load testing External server.
+
+    Runs the connect sequence for given devices, sends Status messages of normal communication
+    and responds to every received Command. Records latency from sending Status to receiving
+    its Status response and, if the module copies status data to commands as the stub module
+    does, latency from sending Status to receiving Command.
+
+    Args:
+    - company_name (str): The name of the company.
+    - car_name (str): The name of the car.
+    - devices (list[internal_protocol.Device]): Devices of the car.
+    - status_size (int): Size of status data in bytes, at least 8 bytes carrying send time.
+    - unix_socket_path (str | None): Connect to Unix socket of External server instead of MQTT broker,
+        the connection is established again whenever External server closes it.
+    """
+
+    def __init__(
+        self,
+        company_name: str,
+        car_name: str,
+        devices: list[internal_protocol.Device],
+        status_size: int = 64,
+        unix_socket_path: str | None = None,
+    ) -> None:
+        self._publish_topic = f"{company_name}/{car_name}/module_gateway"
+        self._subscribe_topic = f"{company_name}/{car_name}/external_server"
+        self._devices = devices
+        self._padding = bytes(max(0, status_size - _TIMESTAMP.size))
+        self._unix_socket_path = unix_socket_path
+        self._mqtt_client = mqtt.Client(
+            callback_api_version=CallbackAPIVersion.VERSION1,
+            client_id="".join(random.choices(string.ascii_uppercase + string.digits, k=20)),
+            protocol=mqtt.MQTTv311,
+        )
+        self._mqtt_client.on_connect = self._on_connect
+        self._mqtt_client.on_message = self._on_message
+        self._subscribed = threading.Event()
+        self._socket: socket.socket | None = None
+        self._socket_lock = threading.Lock()
+        self._socket_thread: threading.Thread | None = None
+        self._stopped = threading.Event()
+
+        self._lock = threading.Lock()
+        self._session_id = ""
+        self._counter = 1
+        self._connect_response = threading.Event()
+        self._connect_response_type: int | None = None
+        # Send times of statuses waiting for Status response by message counter
+        self._pending_statuses: dict[int, int] = dict()
+        self._responses_done = threading.Condition(self._lock)
+        self._commands = 0
+        self.status_latencies: list[float] = []
+        self.command_latencies: list[float] = []
+
+    def start(self, address: str, port: int) -> None:
+        """
+        Connect to the MQTT broker and wait for subscription of External server topic, or connect
+        to the Unix socket if it is given.
+        """
+        if self._unix_socket_path is not None:
+            self._socket_thread = threading.Thread(target=self._socket_loop, daemon=True)
+            self._socket_thread.start()
+            if not self._subscribed.wait(10):
+                raise ConnectionError(f"Not connected to Unix socket {self._unix_socket_path}")
+            return
+        self._mqtt_client.connect(address, port=port)
+        self._mqtt_client.loop_start()
+        if not self._subscribed.wait(10):
+            raise ConnectionError(f"Not connected to MQTT broker {address}:{port}")
+
+    def stop(self) -> None:
+        if self._socket_thread is not None:
+            self._stopped.set()
+            with self._socket_lock:
+                if self._socket is not None:
+                    self._socket.shutdown(socket.SHUT_RDWR)
+            self._socket_thread.join()
+            return
+        self._mqtt_client.loop_stop()
+        self._mqtt_client.disconnect()
+
+    def _on_connect(self, client, _userdata, _flags, _rc) -> None:
+        client.subscribe(self._subscribe_topic, qos=QOS)
+        self._subscribed.set()
+
+    def _socket_loop(self) -> None:
+        """Connects to the Unix socket and receives messages, until stop is called."""
+        while not self._stopped.is_set():
+            connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            try:
+                connection.connect(self._unix_socket_path)
+            except OSError:
+                connection.close()
+                time.sleep(0.05)
+                continue
+            with self._socket_lock:
+                self._socket = connection
+            self._subscribed.set()
+            received = bytearray()
+            try:
+                while data := connection.recv(64 * 1024):
+                    received += data
+                    while len(received) >= _LENGTH.size:
+                        (length,) = _LENGTH.unpack_from(received)
+                        if len(received) < _LENGTH.size + length:
+                            break
+                        self._handle_message(bytes(received[_LENGTH.size : _LENGTH.size + length]))
+                        del received[: _LENGTH.size + length]
+            except OSError:
+                pass
+            with self._socket_lock:
+                self._socket = None
+            connection.close()
+
+    def _on_message(self, _client, _userdata, message: mqtt.MQTTMessage) -> None:
+        self._handle_message(message.payload)
+
+    def _handle_message(self, payload: bytes) -> None:
+        received_at = time.monotonic_ns()
+        msg = external_protocol.ExternalServer.FromString(payload)
+        if msg.HasField("connectResponse"):
+            if msg.connectResponse.sessionId == self._session_id:
+                self._connect_response_type = msg.connectResponse.type
+                self._connect_response.set()
+        elif msg.HasField("statusResponse"):
+            with self._lock:
+                if msg.statusResponse.sessionId != self._session_id:
+                    return
+                # Status response can acknowledge all previous statuses
+                counter = msg.statusResponse.messageCounter
+                sent_at = self._pending_statuses.pop(counter, None)
+                if sent_at is not None:
+                    self.status_latencies.append((received_at - sent_at) / 1e9)
+                # Pending statuses are ordered by counter, they are added in order of sending
+                while self._pending_statuses and (older := next(iter(self._pending_statuses))) < counter:
+                    self.status_latencies.append((received_at - self._pending_statuses.pop(older)) / 1e9)
+                self._responses_done.notify_all()
+        elif msg.HasField("command"):
+            self._respond_command(msg.command)
+            command_data = msg.command.deviceCommand.commandData
+            with self._lock:
+                self._commands += 1
+                if len(command_data) >= _TIMESTAMP.size:
+                    (sent_at,) = _TIMESTAMP.unpack_from(command_data)
+                    self.command_latencies.append((received_at - sent_at) / 1e9)
+                self._responses_done.notify_all()
+
+    def _respond_command(self, command: external_protocol.Command) -> None:
+        msg = external_protocol.ExternalClient()
+        msg.commandResponse.sessionId = command.sessionId
+        msg.commandResponse.type = external_protocol.CommandResponse.Type.OK
+        msg.commandResponse.messageCounter = command.messageCounter
+        self._publish(msg)
+
+    def _publish(self, msg: external_protocol.ExternalClient) -> None:
+        payload = msg.SerializeToString()
+        if self._unix_socket_path is None:
+            self._mqtt_client.publish(self._publish_topic, payload, qos=QOS)
+            return
+        with self._socket_lock:
+            # Messages are lost while External server does not listen, same as without subscriber of MQTT topic
+            if self._socket is not None:
+                try:
+                    self._socket.sendall(_LENGTH.pack(len(payload)) + payload)
+                except OSError:
+                    pass
+
+    def connect(self, timeout: float = 30, retry_interval: float = 1) -> float:
+        """
+        Run the connect sequence with a new session, returns its duration in seconds.
+
+        Connect message is sent again with new session id if it is not responded in retry
+        interval, e.g. when External server has not finished the previous session yet.
+
+        Raises:
+        - TimeoutError: If the connect sequence does not finish in timeout.
+        """
+        start = time.monotonic()
+        deadline = start + timeout
+        while True:
+            with self._lock:
+                self._session_id = "".join(random.choices(string.ascii_lowercase, k=16))
+                self._counter = 1
+                self._pending_statuses.clear()
+                self._commands = 0
+            self._connect_response.clear()
+            msg = external_protocol.ExternalClient()
+            msg.connect.sessionId = self._session_id
+            msg.connect.company = self._publish_topic.split("/")[0]
+            msg.connect.vehicleName = self._publish_topic.split("/")[1]
+            msg.connect.devices.extend(self._devices)
+            self._publish(msg)
+            if self._connect_response.wait(min(retry_interval, max(deadline - time.monotonic(), 0))):
+                break
+            if time.monotonic() >= deadline:
+                raise TimeoutError("Connect message has not been responded")
+        if self._connect_response_type != external_protocol.ConnectResponse.Type.OK:
+            raise ConnectionError(f"Connect message has been refused, type: {self._connect_response_type}")
+
+        for device in self._devices:
+            self.send_status(device, external_protocol.Status.DeviceState.CONNECTING)
+        with self._lock:
+            expected_commands = len(self._devices)
+            if not self._responses_done.wait_for(
+                lambda: not self._pending_statuses and self._commands >= expected_commands,
+                max(deadline - time.monotonic(), 0),
+            ):
+                raise TimeoutError("Connect sequence has not finished")
+        return time.monotonic() - start
+
+    def disconnect(self, timeout: float = 30) -> None:
+        """
+        Announce disconnection of all devices and wait for Status responses, which ends the session.
+        """
+        for device in self._devices:
+            self.send_status(device, external_protocol.Status.DeviceState.DISCONNECT)
+        self.wait_for_status_responses(timeout)
+
+    def send_status(
+        self,
+        device: internal_protocol.Device,
+        state: int = external_protocol.Status.DeviceState.RUNNING,
+    ) -> None:
+        """
+        Send Status message of the device with send time in status data.
+        """
+        msg = external_protocol.ExternalClient()
+        status = msg.status
+        sent_at = time.monotonic_ns()
+        with self._lock:
+            status.sessionId = self._session_id
+            status.messageCounter = self._counter
+            self._pending_statuses[self._counter] = sent_at
+            self._counter += 1
+        status.deviceState = state
+        status.deviceStatus.device.CopyFrom(device)
+        status.deviceStatus.statusData = _TIMESTAMP.pack(sent_at) + self._padding
+        self._publish(msg)
+
+    def wait_for_status_responses(self, timeout: float) -> bool:
+        """
+        Wait until all sent statuses are responded, returns False if some are not responded in timeout.
+        """
+        with self._lock:
+            return self._responses_done.wait_for(lambda: not self._pending_statuses, timeout)
+
+    @property
+    def pending_statuses(self) -> int:
+        return len(self._pending_statuses)
+
+    def take_latencies(self) -> tuple[list[float], list[float]]:
+        """
+        Return recorded status response and command latencies and start recording new ones.
+        """
+        with self._lock:
+            latencies = self.status_latencies, self.command_latencies
+            self.status_latencies, self.command_latencies = [], []
+        return latencies
@@ -0,0 +1,264 @@
+/*
+ * Stub module for load testing External server
+ *
+ * Implements functions of external_server_api.h from Fleet protocol. Every forwarded status
+ * makes a command for the same device, which contains the status data, so the simulated
+ * module gateway can measure latency from sending status to receiving command.
+ *
+ * Config keys:
+ *  - commands_per_status - every n-th forwarded status makes a command, 0 disables commands
+ *    (default 1); External server sends empty command to devices left without command
+ *    in the connect sequence
+ *
+ * Structures are copied from Fleet protocol headers, same as in external_server/structures.py,
+ * so the module can be built without the fleet-protocol submodule:
+ *
+ *     gcc -shared -fPIC -O2 -pthread -DSTUB_MODULE_NUMBER=1 -o libstub_module.so stub_module.c
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef STUB_MODULE_NUMBER
+#define STUB_MODULE_NUMBER 1
+#endif
+
+/* general_error_codes.h */
+#define OK 0
+#define NOT_OK -1
+
+/* external_server_structures.h */
+#define CONTEXT_INCORRECT -11
+#define TIMEOUT_OCCURRED -12
+
+struct buffer {
+	void *data;
+	size_t size;
+};
+
+struct device_identification {
+	int module;
+	unsigned int device_type;
+	struct buffer device_role;
+	struct buffer device_name;
+	unsigned int priority;
+};
+
+struct key_value {
+	struct buffer key;
+	struct buffer value;
+};
+
+struct config {
+	struct key_value *parameters;
+	size_t size;
+};
+
+struct command {
+	struct command *next;
+	struct buffer data;
+	struct device_identification device;
+};
+
+struct context {
+	pthread_mutex_t mutex;
+	pthread_cond_t command_available;
+	struct command *first;
+	struct command *last;
+	size_t command_count;
+	unsigned long commands_per_status;
+	unsigned long forwarded_statuses;
+};
+
+static int copy_buffer(struct buffer *destination, const struct buffer *source) {
+	destination->size = source->size;
+	destination->data = malloc(source->size > 0 ? source->size : 1);
+	if (destination->data == NULL) {
+		destination->size = 0;
+		return NOT_OK;
+	}
+	memcpy(destination->data, source->data, source->size);
+	return OK;
+}
+
+static void free_command(struct command *command) {
+	free(command->data.data);
+	free(command->device.device_role.data);
+	free(command->device.device_name.data);
+	free(command);
+}
+
+static int push_command(struct context *context, const struct buffer *data, const struct device_identification *device) {
+	struct command *command = calloc(1, sizeof(struct command));
+	if (command == NULL) {
+		return NOT_OK;
+	}
+	command->device = *device;
+	if (copy_buffer(&command->data, data) != OK || copy_buffer(&command->device.device_role, &device->device_role) != OK ||
+		copy_buffer(&command->device.device_name, &device->device_name) != OK) {
+		free_command(command);
+		return NOT_OK;
+	}
+
+	pthread_mutex_lock(&context->mutex);
+	if (context->last == NULL) {
+		context->first = command;
+	} else {
+		context->last->next = command;
+	}
+	context->last = command;
+	context->command_count++;
+	pthread_cond_signal(&context->command_available);
+	pthread_mutex_unlock(&context->mutex);
+	return OK;
+}
+
+int get_module_number() {
+	return STUB_MODULE_NUMBER;
+}
+
+void *init(const struct config config_data) {
+	struct context *context = calloc(1, sizeof(struct context));
+	if (context == NULL) {
+		return NULL;
+	}
+	pthread_mutex_init(&context->mutex, NULL);
+	pthread_cond_init(&context->command_available, NULL);
+	context->commands_per_status = 1;
+	for (size_t i = 0; i < config_data.size; i++) {
+		const struct key_value *parameter = &config_data.parameters[i];
+		if (parameter->key.size == strlen("commands_per_status") &&
+			memcmp(parameter->key.data, "commands_per_status", parameter->key.size) == 0) {
+			char value[32] = {0};
+			memcpy(value, parameter->value.data, parameter->value.size < sizeof(value) - 1 ? parameter->value.size : sizeof(value) - 1);
+			context->commands_per_status = strtoul(value, NULL, 10);
+		}
+	}
+	return context;
+}
+
+int destroy(void **context_ptr) {
+	if (context_ptr == NULL || *context_ptr == NULL) {
+		return CONTEXT_INCORRECT;
+	}
+	struct context *context = *context_ptr;
+	while (context->first != NULL) {
+		struct command *next = context->first->next;
+		free_command(context->first);
+		context->first = next;
+	}
+	pthread_cond_destroy(&context->command_available);
+	pthread_mutex_destroy(&context->mutex);
+	free(context);
+	*context_ptr = NULL;
+	return OK;
+}
+
+void deallocate(struct buffer *buffer) {
+	if (buffer != NULL) {
+		free(buffer->data);
+		buffer->data = NULL;
+		buffer->size = 0;
+	}
+}
+
+/* Optional, all calls are guarded by the context mutex, so the module is CONCURRENT (2) */
+int get_thread_safety() {
+	return 2;
+}
+
+int is_device_type_supported(unsigned int device_type) {
+	(void)device_type;
+	return OK;
+}
+
+int device_connected(const struct device_identification device, void *context) {
+	(void)device;
+	return context != NULL ? OK : CONTEXT_INCORRECT;
+}
+
+int device_disconnected(const int disconnect_type, const struct device_identification device, void *context) {
+	(void)disconnect_type;
+	(void)device;
+	return context != NULL ? OK : CONTEXT_INCORRECT;
+}
+
+int forward_status(const struct buffer device_status, const struct device_identification device, void *context_ptr) {
+	struct context *context = context_ptr;
+	if (context == NULL) {
+		return CONTEXT_INCORRECT;
+	}
+	pthread_mutex_lock(&context->mutex);
+	unsigned long forwarded = context->forwarded_statuses++;
+	pthread_mutex_unlock(&context->mutex);
+	if (context->commands_per_status == 0 || forwarded % context->commands_per_status != 0) {
+		return OK;
+	}
+	return push_command(context, &device_status, &device);
+}
+
+int forward_error_message(const struct buffer error_msg, const struct device_identification device, void *context) {
+	(void)error_msg;
+	(void)device;
+	return context != NULL ? OK : CONTEXT_INCORRECT;
+}
+
+int wait_for_command(int timeout_time_in_ms, void *context_ptr) {
+	struct context *context = context_ptr;
+	if (context == NULL) {
+		return CONTEXT_INCORRECT;
+	}
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_time_in_ms / 1000;
+	deadline.tv_nsec += (long)(timeout_time_in_ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	int rc = OK;
+	pthread_mutex_lock(&context->mutex);
+	while (context->command_count == 0 && rc == OK) {
+		if (pthread_cond_timedwait(&context->command_available, &context->mutex, &deadline) == ETIMEDOUT) {
+			rc = context->command_count == 0 ? TIMEOUT_OCCURRED : OK;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&context->mutex);
+	return rc;
+}
+
+int pop_command(struct buffer *command, struct device_identification *device, void *context_ptr) {
+	struct context *context = context_ptr;
+	if (context == NULL) {
+		return CONTEXT_INCORRECT;
+	}
+	pthread_mutex_lock(&context->mutex);
+	struct command *first = context->first;
+	if (first == NULL) {
+		pthread_mutex_unlock(&context->mutex);
+		return NOT_OK;
+	}
+	context->first = first->next;
+	if (context->first == NULL) {
+		context->last = NULL;
+	}
+	int remaining = (int)--context->command_count;
+	pthread_mutex_unlock(&context->mutex);
+
+	/* Buffers are handed over to External server, which frees them by deallocate */
+	*command = first->data;
+	*device = first->device;
+	free(first);
+	return remaining;
+}
+
+int command_ack(const struct buffer command, const struct device_identification device, void *context) {
+	(void)command;
+	(void)device;
+	return context != NULL ? OK : CONTEXT_INCORRECT;
+}
@@ -0,0 +1,246 @@
+/*
+ * Optional native fast path of ExternalServerApiClient
+ *
+ * Calls forward_status and forward_status_batch of a module library directly, without creating
+ * ctypes structures for every status. Structures of device identifications and buffers are
+ * built on the stack (or in one allocation for batches) from Python objects and the module
+ * function is called with the GIL released, so other threads of External server run while
+ * the module handles statuses. Locking of module calls stays in Python.
+ *
+ * Structures are copied from Fleet protocol headers, same as in external_server/structures.py,
+ * so the extension can be built without the fleet-protocol submodule. From this directory:
+ *
+ *     gcc -shared -fPIC -O2 $(python3-config --includes) -o external_server/_fastpath$(python3-config --extension-suffix) external_server/_fastpath.c
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+struct buffer {
+	void *data;
+	size_t size;
+};
+
+struct device_identification {
+	int module;
+	unsigned int device_type;
+	struct buffer device_role;
+	struct buffer device_name;
+	unsigned int priority;
+};
+
+typedef int (*forward_status_function)(const struct buffer, const struct device_identification, void *);
+typedef int (*forward_status_batch_function)(const struct buffer *, const struct device_identification *, size_t,
+					     void *);
+
+/* Objects referenced by structures of one status, released after the module call */
+struct status_references {
+	PyObject *device_role;
+	PyObject *device_name;
+};
+
+static void release_references(struct status_references *references) {
+	Py_CLEAR(references->device_role);
+	Py_CLEAR(references->device_name);
+}
+
+static int get_pointer(PyObject *object, void **pointer) {
+	if (object == Py_None) {
+		*pointer = NULL;
+		return 1;
+	}
+	*pointer = PyLong_AsVoidPtr(object);
+	return !PyErr_Occurred();
+}
+
+static int get_unsigned_attribute(PyObject *device, const char *name, unsigned int *value) {
+	PyObject *attribute = PyObject_GetAttrString(device, name);
+	if (attribute == NULL) {
+		return 0;
+	}
+	unsigned long number = PyLong_AsUnsignedLong(attribute);
+	Py_DECREF(attribute);
+	if (PyErr_Occurred()) {
+		return 0;
+	}
+	*value = (unsigned int)number;
+	return 1;
+}
+
+static int get_string_attribute(PyObject *device, const char *name, struct buffer *buffer, PyObject **reference) {
+	PyObject *attribute = PyObject_GetAttrString(device, name);
+	if (attribute == NULL) {
+		return 0;
+	}
+	Py_ssize_t size;
+	const char *data = PyUnicode_AsUTF8AndSize(attribute, &size);
+	if (data == NULL) {
+		Py_DECREF(attribute);
+		return 0;
+	}
+	/* UTF-8 representation is owned by the string, which is kept until the module call returns */
+	buffer->data = (void *)data;
+	buffer->size = (size_t)size;
+	*reference = attribute;
+	return 1;
+}
+
+/*
+ * Fills structures of one status, same as ExternalServerApiClient._create_device_identification.
+ * References are set even on failure.
+ */
+static int fill_status(PyObject *device_object, PyObject *status_object, struct buffer *status,
+		       struct device_identification *device, struct status_references *references) {
+	references->device_role = NULL;
+	references->device_name = NULL;
+	char *data;
+	Py_ssize_t size;
+	if (PyBytes_AsStringAndSize(status_object, &data, &size) < 0) {
+		return 0;
+	}
+	status->data = data;
+	status->size = (size_t)size;
+
+	PyObject *module = PyObject_GetAttrString(device_object, "module");
+	if (module == NULL) {
+		return 0;
+	}
+	device->module = (int)PyLong_AsLong(module);
+	Py_DECREF(module);
+	if (PyErr_Occurred()) {
+		return 0;
+	}
+	return get_unsigned_attribute(device_object, "deviceType", &device->device_type) &&
+	       get_unsigned_attribute(device_object, "priority", &device->priority) &&
+	       get_string_attribute(device_object, "deviceRole", &device->device_role, &references->device_role) &&
+	       get_string_attribute(device_object, "deviceName", &device->device_name, &references->device_name);
+}
+
+PyDoc_STRVAR(forward_status_doc,
+	     "forward_status(function, context, device, status) -> int\n\n"
+	     "Calls forward_status of a module library at address function with the GIL released.");
+
+static PyObject *forward_status(PyObject *self, PyObject *args) {
+	PyObject *function_object, *context_object, *device_object, *status_object;
+	if (!PyArg_ParseTuple(args, "OOOO:forward_status", &function_object, &context_object, &device_object,
+			      &status_object)) {
+		return NULL;
+	}
+	void *function_pointer, *context;
+	if (!get_pointer(function_object, &function_pointer) || !get_pointer(context_object, &context)) {
+		return NULL;
+	}
+	if (function_pointer == NULL) {
+		PyErr_SetString(PyExc_ValueError, "function address must not be NULL");
+		return NULL;
+	}
+
+	struct buffer status;
+	struct device_identification device;
+	struct status_references references;
+	if (!fill_status(device_object, status_object, &status, &device, &references)) {
+		release_references(&references);
+		return NULL;
+	}
+
+	forward_status_function function = (forward_status_function)function_pointer;
+	int rc;
+	Py_BEGIN_ALLOW_THREADS
+	rc = function(status, device, context);
+	Py_END_ALLOW_THREADS
+
+	release_references(&references);
+	return PyLong_FromLong(rc);
+}
+
+PyDoc_STRVAR(forward_status_batch_doc,
+	     "forward_status_batch(function, context, statuses) -> int\n\n"
+	     "Calls forward_status_batch of a module library at address function with the GIL released.\n"
+	     "statuses is a list of (device, status bytes) tuples.");
+
+static PyObject *forward_status_batch(PyObject *self, PyObject *args) {
+	PyObject *function_object, *context_object, *statuses;
+	if (!PyArg_ParseTuple(args, "OOO!:forward_status_batch", &function_object, &context_object, &PyList_Type,
+			      &statuses)) {
+		return NULL;
+	}
+	void *function_pointer, *context;
+	if (!get_pointer(function_object, &function_pointer) || !get_pointer(context_object, &context)) {
+		return NULL;
+	}
+	if (function_pointer == NULL) {
+		PyErr_SetString(PyExc_ValueError, "function address must not be NULL");
+		return NULL;
+	}
+
+	/* The list is copied, so that items are kept even if the list is changed by another thread */
+	PyObject *items = PySequence_Tuple(statuses);
+	if (items == NULL) {
+		return NULL;
+	}
+	Py_ssize_t count = PyTuple_GET_SIZE(items);
+	size_t allocated = count > 0 ? (size_t)count : 1;
+	struct buffer *buffers = PyMem_Calloc(allocated, sizeof(struct buffer));
+	struct device_identification *devices = PyMem_Calloc(allocated, sizeof(struct device_identification));
+	struct status_references *references = PyMem_Calloc(allocated, sizeof(struct status_references));
+	PyObject *result = NULL;
+	Py_ssize_t filled = 0;
+	if (buffers == NULL || devices == NULL || references == NULL) {
+		PyErr_NoMemory();
+		goto cleanup;
+	}
+
+	for (; filled < count; filled++) {
+		PyObject *item = PyTuple_GET_ITEM(items, filled);
+		if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+			PyErr_SetString(PyExc_TypeError, "status must be a tuple of device and bytes");
+			goto cleanup;
+		}
+		if (!fill_status(PyTuple_GET_ITEM(item, 0), PyTuple_GET_ITEM(item, 1), &buffers[filled], &devices[filled],
+				 &references[filled])) {
+			filled++;
+			goto cleanup;
+		}
+	}
+
+	forward_status_batch_function function = (forward_status_batch_function)function_pointer;
+	int rc;
+	Py_BEGIN_ALLOW_THREADS
+	rc = function(buffers, devices, (size_t)count, context);
+	Py_END_ALLOW_THREADS
+	result = PyLong_FromLong(rc);
+
+cleanup:
+	if (references != NULL) {
+		for (Py_ssize_t i = 0; i < filled; i++) {
+			release_references(&references[i]);
+		}
+	}
+	PyMem_Free(references);
+	PyMem_Free(devices);
+	PyMem_Free(buffers);
+	Py_DECREF(items);
+	return result;
+}
+
+static PyMethodDef fastpath_methods[] = {
+	{"forward_status", forward_status, METH_VARARGS, forward_status_doc},
+	{"forward_status_batch", forward_status_batch, METH_VARARGS, forward_status_batch_doc},
+	{NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef fastpath_module = {
+	PyModuleDef_HEAD_INIT,
+	"_fastpath",
+	"Native fast path of module API calls",
+	-1,
+	fastpath_methods,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+};
+
+PyMODINIT_FUNC PyInit__fastpath(void) {
+	return PyModule_Create(&fastpath_module);
+}
@@ -1,11 +1,14 @@
 __all__ = (
     "CommandMessagesChecker",
     "Checker",
+    "Deadline",
+    "DeadlineScheduler",
     "OrderChecker",
     "SessionTimeoutChecker",
 )
 
 from .command_messages_checker import CommandMessagesChecker
 from .checker import Checker
+from .deadline_scheduler import Deadline, DeadlineScheduler
 from .order_checker import OrderChecker
 from .session_timeout_checker import SessionTimeoutChecker
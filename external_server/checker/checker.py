@@ -1,8 +1,10 @@
 import threading
 import logging
 
+from external_server.checker.deadline_scheduler import Deadline, DeadlineScheduler
+from external_server.metrics import MetricsRegistry
 from external_server.structures import TimeoutType
-from external_server.event_queue import EventQueueSingleton, EventType
+from external_server.event_queue import EventQueue, EventQueueSingleton, EventType
 
 
 class Checker:
@@ -10,21 +12,42 @@ class Checker:
     A class that provides a mechanism to check for a timeout in a threaded operation.
     """
 
-    def __init__(self, timeout_type: TimeoutType) -> None:
+    def __init__(
+        self, timeout_type: TimeoutType, event_queue: EventQueue | None = None, car_name: str = ""
+    ) -> None:
         """
         Initializes a new instance of the Checker class with the specified timeout type to signal when timeout occurs.
 
         Args:
         - timeout_type (TimeoutType): TimeoutType to put onto event queue when timeout occurs
+        - event_queue (EventQueue | None): queue the timeout is reported to, EventQueueSingleton if not given
+        - car_name (str): name of the car used as label of checker metrics
         """
         self._logger = logging.getLogger(self.__class__.__name__)
 
         self.time_out = threading.Event()
-        self._event_queue = EventQueueSingleton()
+        self._event_queue = event_queue if event_queue is not None else EventQueueSingleton()
         self._timeout_type = timeout_type
+        self._scheduler = DeadlineScheduler()
+        self._timeouts = MetricsRegistry().counter(
+            "external_server_timeouts_total",
+            "Number of occurred timeouts",
+            car=car_name,
+            type=timeout_type.name.lower(),
+        )
+
+    def _start_timer(self, timeout: float) -> Deadline:
+        """
+        Schedules the timeout on the shared DeadlineScheduler. Returned deadline can be cancelled.
+
+        Args:
+        - timeout (float): time in seconds after which the timeout occurs
+        """
+        return self._scheduler.schedule(timeout, self._timeout_occurred)
 
     def _timeout_occurred(self) -> None:
         """
         Puts the TIMEOUT_OCCURRED event to event queue.
         """
+        self._timeouts.inc()
         self._event_queue.add_event(event_type=EventType.TIMEOUT_OCCURRED, data=self._timeout_type)
@@ -1,12 +1,18 @@
-import threading
-from queue import Queue
+import collections
 import sys
+import time
 
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 import ExternalProtocol_pb2 as external_protocol
+import InternalProtocol_pb2 as internal_protocol
 from external_server.checker.checker import Checker
+from external_server.checker.deadline_scheduler import Deadline
+from external_server.device_registry import DeviceRegistry
 from external_server.structures import TimeoutType
+from external_server.event_queue import EventQueue
+from external_server.metrics import MetricsRegistry
+from external_server.logs import COMMAND_RESPONSE_LOG
 
 
 class CommandMessagesChecker(Checker):
@@ -15,22 +21,45 @@ class CommandMessagesChecker(Checker):
     Checks for order of received Command responses and checks if duration between
     sending Command and receiving Command reponses do not exceeds timeout given in
     constructor. Is also External server's memory of commands, which didn't have
-    received Command response yet.
+    received Command response yet. Records time between adding command and its
+    acknowledgement to round trip histogram.
+
+    Commands are kept in a deque ordered by their counters, which follow each other, so
+    command acknowledged out of order is found by its offset from the oldest command and
+    marked in a bitmap. Only the oldest not acknowledged command has a running timeout,
+    every other command was sent later and would time out later.
     """
 
-    def __init__(self, timeout: int) -> None:
-        super().__init__(TimeoutType.COMMAND_TIMEOUT)
+    def __init__(self, timeout: int, event_queue: EventQueue | None = None, car_name: str = "") -> None:
+        super().__init__(TimeoutType.COMMAND_TIMEOUT, event_queue, car_name)
         self._timeout = timeout
-        self._commands: Queue[
-            tuple[external_protocol.Command, int, bool, threading.Timer]
-        ] = Queue()
-        self._received_acks: list[int] = []
+        self._round_trip = MetricsRegistry().histogram(
+            "external_server_command_round_trip_seconds",
+            "Time between sending Command and receiving its Command response",
+            car=car_name,
+        )
+        # (command, counter, returned_from_api, time of sending), counters follow each other
+        self._commands: collections.deque[
+            tuple[external_protocol.Command, int, bool, float]
+        ] = collections.deque()
+        # Bit i is set if command self._commands[i] has been acknowledged before older commands
+        self._received_acks = 0
         self._counter = 0
+        # Timeout of the oldest not acknowledged command
+        self._deadline: Deadline | None = None
+        # Timeouts do not count time before this moment, moved when timers are resumed
+        self._timeouts_since = 0.0
+        # Number of not acknowledged commands per device
+        self._device_command_counts: dict[tuple[int, int, str], int] = dict()
 
     @property
     def counter(self) -> int:
         return self._counter
 
+    def device_command_count(self, device: internal_protocol.Device) -> int:
+        """Returns number of commands for the device, which were not acknowledged yet."""
+        return self._device_command_counts.get(DeviceRegistry.key(device), 0)
+
     def add_command(self, command: external_protocol.Command, returned_from_api: bool) -> None:
         """Adds command to checker
 
@@ -38,10 +67,12 @@ class CommandMessagesChecker(Checker):
         the returned_from_api to True if command was returned by get_command API
         function. Should be called when command is sent to Module gateway.
         """
-        timer = threading.Timer(self._timeout, self._timeout_occurred)
-        timer.start()
-        self._commands.put((command, self._counter, returned_from_api, timer))
+        self._commands.append((command, self._counter, returned_from_api, time.monotonic()))
         self._counter += 1
+        key = DeviceRegistry.key(command.deviceCommand.device)
+        self._device_command_counts[key] = self._device_command_counts.get(key, 0) + 1
+        if self._deadline is None:
+            self._update_deadline()
 
     def pop_commands(self, msg_counter: int) -> list[tuple[external_protocol.Command, bool]]:
         """Pops commands from checker
@@ -49,52 +80,87 @@ class CommandMessagesChecker(Checker):
         Returns list of Command messages, which have been acknowledged with Command
         responses in correct order. With every command the returned_from_api flag is
         also returned. Can return empty list if received Command responses in wrong
-        order. Stops the timer for acknowledged commands. Should be called when Command
-        response from Module gateway is received.
+        order. Moves the timeout to the oldest command still waiting for its Command
+        response. Should be called when Command response from Module gateway is received.
 
         Parameters
         ----------
         msg_counter : int
             number of command, which was acknowledged by received commandResponse
         """
-        command_list = list()
-        if self._commands.empty() or msg_counter != self._commands.queue[0][1]:
-            self._received_acks.append(msg_counter)
+        command_list: list[tuple[external_protocol.Command, bool]] = list()
+        index = msg_counter - self._commands[0][1] if self._commands else -1
+        if index < 0 or index >= len(self._commands) or self._received_acks >> index & 1:
             self._logger.warning(
-                f"Command response message has been received in bad order: {msg_counter}"
+                f"Command response message with unknown or already acknowledged counter has been received: {msg_counter}"
             )
             return command_list
 
-        command, _, returned_from_api, timer = self._commands.get()
-        command_list.append((command, returned_from_api))
-
-        self._stop_timer(timer)
-        self._logger.info(
-            f"Received Command response message was acknowledged, messageCounter: {msg_counter}"
-        )
-        while self._received_acks:
-            counter = self._commands.queue[0][1]
-            if counter in self._received_acks:
-                command, _, returned_from_api, timer = self._commands.get()
-                command_list.append((command, returned_from_api))
-                self._stop_timer(timer)
-                self._received_acks.remove(counter)
-                self._logger.info(
-                    f"Older Command response message was acknowledged, messageCounter: {counter}"
-                )
-                continue
-            break
+        self._round_trip.observe(time.monotonic() - self._commands[index][3])
+        self._received_acks |= 1 << index
+        if index != 0:
+            self._logger.warning(
+                f"Command response message has been received in bad order: {msg_counter}"
+            )
+            return command_list
 
+        count = (~self._received_acks & (self._received_acks + 1)).bit_length() - 1
+        self._received_acks >>= count
+        for _ in range(count):
+            command, counter, returned_from_api, _ = self._commands.popleft()
+            command_list.append((command, returned_from_api))
+            self._command_acknowledged(command)
+            self._logger.info(
+                "Received Command response message was acknowledged, messageCounter: %d",
+                counter,
+                extra=COMMAND_RESPONSE_LOG,
+            )
+        self._cancel_deadline()
+        self._update_deadline()
         return command_list
 
-    def _stop_timer(self, timer: threading.Timer) -> None:
-        timer.cancel()
-        timer.join()
+    def disown_module_commands(self, module_number: int) -> None:
+        """Marks not acknowledged commands for devices of the module as not returned from API
+
+        Their Command responses are still expected, but the commands are not acknowledged to the
+        module. Should be called when the module instance, which returned the commands, is replaced.
+        """
+        for index, (command, counter, returned_from_api, sent_at) in enumerate(self._commands):
+            if returned_from_api and command.deviceCommand.device.module == module_number:
+                self._commands[index] = (command, counter, False, sent_at)
+
+    def _update_deadline(self) -> None:
+        """Starts the timeout of the oldest not acknowledged command, if there is any."""
+        if self._commands:
+            sent_at = max(self._commands[0][3], self._timeouts_since)
+            self._deadline = self._start_timer(max(sent_at + self._timeout - time.monotonic(), 0))
+
+    def _cancel_deadline(self) -> None:
+        if self._deadline is not None:
+            self._deadline.cancel()
+            self._deadline = None
+
+    def _command_acknowledged(self, command: external_protocol.Command) -> None:
+        key = DeviceRegistry.key(command.deviceCommand.device)
+        count = self._device_command_counts.get(key, 0) - 1
+        if count > 0:
+            self._device_command_counts[key] = count
+        else:
+            self._device_command_counts.pop(key, None)
+
+    def suspend_timers(self) -> None:
+        """Cancels the timeout of not acknowledged commands, commands are kept in memory."""
+        self._cancel_deadline()
+
+    def resume_timers(self) -> None:
+        """Restarts the timeout of commands, which were not acknowledged when timers were suspended."""
+        self._timeouts_since = time.monotonic()
+        self._update_deadline()
 
     def reset(self) -> None:
-        """Stops all timers and clears command memory"""
-        while not self._commands.empty():
-            _, _, _, timer = self._commands.get()
-            self._stop_timer(timer)
-        self._received_acks.clear()
+        """Stops the timeout and clears command memory"""
+        self._cancel_deadline()
+        self._commands.clear()
+        self._received_acks = 0
+        self._device_command_counts.clear()
         self.time_out.clear()
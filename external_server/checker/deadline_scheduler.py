@@ -0,0 +1,115 @@
+import heapq
+import itertools
+import logging
+import threading
+import time
+from typing import Callable
+
+from external_server.utils import SingletonMeta
+
+
+class Deadline:
+    """Handle of a callback scheduled by DeadlineScheduler."""
+
+    __slots__ = ("when", "_callback", "_cancelled", "_scheduled", "_scheduler")
+
+    def __init__(self, when: float, callback: Callable[[], None], scheduler: "DeadlineScheduler") -> None:
+        self.when = when
+        self._callback = callback
+        self._cancelled = False
+        self._scheduled = True
+        self._scheduler = scheduler
+
+    @property
+    def cancelled(self) -> bool:
+        return self._cancelled
+
+    def cancel(self) -> None:
+        """Cancels the deadline. Does not block, callback is not called if it has not been called yet."""
+        if not self._cancelled:
+            self._cancelled = True
+            if self._scheduled:
+                self._scheduler._deadline_cancelled()
+
+
+class DeadlineScheduler(metaclass=SingletonMeta):
+    """Heap based scheduler of deadlines shared by all checkers
+
+    Calls callbacks of expired deadlines from a single thread, which is started with the
+    first scheduled deadline. Cancelled deadlines are only marked as cancelled and are
+    removed from the heap when they expire or when they make up most of the heap.
+    """
+
+    # Heap is rebuilt without cancelled deadlines when they exceed this share of the heap
+    _COMPACTION_RATIO = 0.5
+    _COMPACTION_MIN_SIZE = 64
+
+    def __init__(self) -> None:
+        self._logger = logging.getLogger(self.__class__.__name__)
+
+        self._heap: list[tuple[float, int, Deadline]] = []
+        self._sequence = itertools.count()
+        self._cancelled_count = 0
+        self._condition = threading.Condition()
+        self._thread: threading.Thread | None = None
+
+    def schedule(self, delay: float, callback: Callable[[], None]) -> Deadline:
+        """Schedules callback to be called after delay seconds
+
+        Parameters
+        ----------
+        delay : float
+            time in seconds after which the callback is called
+
+        callback : Callable[[], None]
+            function called on scheduler thread when deadline expires
+        """
+        deadline = Deadline(time.monotonic() + delay, callback, self)
+        with self._condition:
+            heapq.heappush(self._heap, (deadline.when, next(self._sequence), deadline))
+            if self._thread is None:
+                self._thread = threading.Thread(target=self._run, name=self.__class__.__name__, daemon=True)
+                self._thread.start()
+            elif self._heap[0][2] is deadline:
+                self._condition.notify()
+        return deadline
+
+    def _deadline_cancelled(self) -> None:
+        with self._condition:
+            self._cancelled_count += 1
+            if (
+                len(self._heap) >= self._COMPACTION_MIN_SIZE
+                and self._cancelled_count > len(self._heap) * self._COMPACTION_RATIO
+            ):
+                self._heap = [item for item in self._heap if not item[2].cancelled]
+                heapq.heapify(self._heap)
+                self._cancelled_count = 0
+
+    def _pop_expired(self) -> list[Deadline]:
+        now = time.monotonic()
+        expired = []
+        while self._heap and self._heap[0][0] <= now:
+            _, _, deadline = heapq.heappop(self._heap)
+            deadline._scheduled = False
+            if deadline.cancelled:
+                self._cancelled_count = max(0, self._cancelled_count - 1)
+            else:
+                expired.append(deadline)
+        return expired
+
+    def _run(self) -> None:
+        while True:
+            with self._condition:
+                expired = self._pop_expired()
+                if not expired:
+                    timeout = self._heap[0][0] - time.monotonic() if self._heap else None
+                    self._condition.wait(timeout)
+                    continue
+            for deadline in expired:
+                # Deadline could have been cancelled after it was popped from the heap
+                if deadline.cancelled:
+                    continue
+                try:
+                    deadline._callback()
+                except Exception as e:
+                    self._logger.error(f"Error occurred in deadline callback: {e}")
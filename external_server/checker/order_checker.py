@@ -1,75 +1,142 @@
-import threading
-from queue import PriorityQueue, Queue
+import collections
 import sys
+import time
 
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 import ExternalProtocol_pb2 as external_protocol
 from external_server.checker.checker import Checker
+from external_server.checker.deadline_scheduler import Deadline
 from external_server.structures import TimeoutType
+from external_server.event_queue import EventQueue
+from external_server.metrics import MetricsRegistry
+from external_server.logs import STATUS_LOG
 
 
 class OrderChecker(Checker):
-    def __init__(self, timeout: int) -> None:
-        super().__init__(TimeoutType.MESSAGE_TIMEOUT)
+    """Checks that statuses are handled in order of their message counters
+
+    Statuses received ahead of the expected counter are kept in a reorder buffer, a ring of
+    window_size slots indexed by counter modulo window_size. Bit i of the received bitmap is set
+    if status with counter expected + i is in the buffer. Only one deadline runs, it belongs to
+    the oldest missing status. A status more than window_size ahead of the expected counter
+    cannot be buffered and causes the timeout immediately.
+    """
+
+    WINDOW_SIZE = 1024
+
+    def __init__(
+        self,
+        timeout: int,
+        event_queue: EventQueue | None = None,
+        car_name: str = "",
+        window_size: int = WINDOW_SIZE,
+    ) -> None:
+        super().__init__(TimeoutType.MESSAGE_TIMEOUT, event_queue, car_name)
+        self._out_of_order_statuses = MetricsRegistry().counter(
+            "external_server_out_of_order_statuses_total",
+            "Number of status messages received with unexpected message counter",
+            car=car_name,
+        )
         self._timeout = timeout
+        self._window_size = window_size
         self._counter = 1
-        self._received_statuses: PriorityQueue[
-            tuple[int, external_protocol.Status]
-        ] = PriorityQueue()
-        self._missing_statuses: PriorityQueue[tuple[int, threading.Timer]] = PriorityQueue()
-        self._checked_statuses: Queue[external_protocol.Status] = Queue()
+        self._buffer: list[external_protocol.Status | None] = [None] * window_size
+        self._received = 0
+        # Counter following the highest received counter
+        self._next_counter = 1
+        # (end counter, detection time), counters below end not received until detection time are missing since then
+        self._gaps: collections.deque[tuple[int, float]] = collections.deque()
+        self._deadline: Deadline | None = None
+        self._deadline_counter = 0
+        self._checked_statuses: collections.deque[external_protocol.Status] = collections.deque()
 
     def check(self, status_msg: external_protocol.Status) -> None:
         status_counter = status_msg.messageCounter
-        self._received_statuses.put((status_counter, status_msg))
-        if status_counter == self._counter:
-            self._remove_missing_status()
+        offset = status_counter - self._counter
+        if offset < 0 or (offset < self._window_size and self._received >> offset & 1):
+            self._out_of_order_statuses.inc()
+            self._logger.warning(f"Status message with counter {status_counter} has already been received")
+            return
+        if offset >= self._window_size:
+            self._out_of_order_statuses.inc()
+            self._logger.error(
+                f"Status message with counter {status_counter} is too far ahead of missing status "
+                f"with counter {self._counter}"
+            )
+            self._timeout_occurred()
             return
 
-        for missing_counter in range(self._counter, status_counter + 1):
-            if (
-                self._missing_statuses.empty()
-                or missing_counter
-                > self._missing_statuses.queue[self._missing_statuses.qsize() - 1][0]
-            ):
-                timer = threading.Timer(self._timeout, self._timeout_occurred)
-                timer.start()
-                self._missing_statuses.put((missing_counter, timer))
-                self._logger.warning(f"Status message with counter {missing_counter} is missing")
-
-    def _remove_missing_status(self):
-        if self._missing_statuses.empty():
-            self._add_checked_status()
+        self._buffer[status_counter % self._window_size] = status_msg
+        self._received |= 1 << offset
+        if status_counter >= self._next_counter:
+            if status_counter > self._next_counter:
+                self._gaps.append((status_counter, time.monotonic()))
+                if status_counter - self._next_counter == 1:
+                    self._logger.warning(f"Status message with counter {self._next_counter} is missing")
+                else:
+                    self._logger.warning(
+                        f"Status messages with counters from {self._next_counter} to {status_counter - 1} are missing"
+                    )
+            self._next_counter = status_counter + 1
+        if offset == 0:
+            self._add_checked_statuses()
+        else:
+            self._out_of_order_statuses.inc()
+        self._update_deadline()
+
+    def _add_checked_statuses(self) -> None:
+        """Moves all statuses following each other from the start of the buffer to checked statuses."""
+        count = (~self._received & (self._received + 1)).bit_length() - 1
+        for _ in range(count):
+            index = self._counter % self._window_size
+            self._checked_statuses.append(self._buffer[index])
+            self._buffer[index] = None
+            self._logger.info(
+                "Status message with counter %d has been succesfully checked", self._counter, extra=STATUS_LOG
+            )
+            self._counter += 1
+        self._received >>= count
+
+    def _update_deadline(self) -> None:
+        """Keeps the deadline running for the oldest missing status, if there is any."""
+        if self._received == 0:
+            self._gaps.clear()
+            self._cancel_deadline()
             return
-        while (
-            not self._received_statuses.empty()
-            and self._counter == self._received_statuses.queue[0][0]
-            and self._counter == self._missing_statuses.queue[0][0]
-        ):
-            self._pop_timer()
-            self._add_checked_status()
-
-    def _add_checked_status(self):
-        status_counter, status = self._received_statuses.get()
-        self._checked_statuses.put(status)
-        self._counter += 1
-        self._logger.info(
-            f"Status message with counter {status_counter} has been succesfully checked"
-        )
+        if self._deadline is not None and self._deadline_counter == self._counter:
+            return
+        while self._gaps[0][0] <= self._counter:
+            self._gaps.popleft()
+        self._cancel_deadline()
+        remaining = self._gaps[0][1] + self._timeout - time.monotonic()
+        self._deadline = self._start_timer(max(remaining, 0))
+        self._deadline_counter = self._counter
 
-    def _pop_timer(self) -> None:
-        _, timer = self._missing_statuses.get()
-        timer.cancel()
-        timer.join()
+    def _cancel_deadline(self) -> None:
+        if self._deadline is not None:
+            self._deadline.cancel()
+            self._deadline = None
 
     def get_status(self) -> external_protocol.Status | None:
-        return self._checked_statuses.get_nowait() if not self._checked_statuses.empty() else None
+        return self._checked_statuses.popleft() if self._checked_statuses else None
+
+    def suspend_timers(self) -> None:
+        """Cancels the timer of missing statuses, missing statuses are still expected."""
+        self._cancel_deadline()
+
+    def resume_timers(self) -> None:
+        """Restarts the timeout of statuses, which were missing when timers were suspended."""
+        now = time.monotonic()
+        self._gaps = collections.deque((end, now) for end, _ in self._gaps)
+        self._update_deadline()
 
     def reset(self) -> None:
-        while not self._missing_statuses.empty():
-            self._pop_timer()
-        self._received_statuses.queue.clear()
-        self._checked_statuses.queue.clear()
+        self._cancel_deadline()
+        self._buffer = [None] * self._window_size
+        self._received = 0
+        self._gaps.clear()
+        self._checked_statuses.clear()
         self.time_out.clear()
         self._counter = 1
+        self._next_counter = 1
@@ -1,7 +1,7 @@
-import threading
-
 from external_server.checker.checker import Checker
+from external_server.checker.deadline_scheduler import Deadline
 from external_server.structures import TimeoutType
+from external_server.event_queue import EventQueue
 
 
 class SessionTimeoutChecker(Checker):
@@ -12,22 +12,21 @@ class SessionTimeoutChecker(Checker):
     message in given timeout, then connected session is timed out
     """
 
-    def __init__(self, timeout: int) -> None:
-        super().__init__(TimeoutType.SESSION_TIMEOUT)
+    def __init__(self, timeout: int, event_queue: EventQueue | None = None, car_name: str = "") -> None:
+        super().__init__(TimeoutType.SESSION_TIMEOUT, event_queue, car_name)
         self._timeout = timeout
-        self._timer: threading.Timer | None = None
+        self._timer: Deadline | None = None
         self._timer_running = False
 
     def start(self) -> None:
-        self._timer = threading.Timer(self._timeout, self._timeout_occurred)
-        self._timer.start()
+        if self._timer_running and self._timer is not None:
+            self._timer.cancel()
+        self._timer = self._start_timer(self._timeout)
         self._timer_running = True
 
     def stop(self) -> None:
         if self._timer_running and self._timer is not None:
-            if self._timer.is_alive():
-                self._timer.cancel()
-                self._timer.join()
+            self._timer.cancel()
             self.time_out.clear()
             self._timer_running = False
 
@@ -0,0 +1,192 @@
+import threading
+import time
+import zlib
+from enum import IntEnum
+from typing import Callable
+
+from external_server import constants
+from external_server.config import Config
+from external_server.exceptions import PayloadDecodeError
+from external_server.metrics import MetricsRegistry
+
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+try:
+    import lz4.block
+except ImportError:
+    lz4 = None
+
+
+class Compression(IntEnum):
+    NONE = 0
+    ZLIB = 1
+    ZSTD = 2
+    LZ4 = 3
+
+
+class PayloadCodec:
+    """Optional compression of ExternalServer and ExternalClient payloads sent over MQTT
+
+    Compressed payload starts with MARKER byte followed by Compression id of the algorithm and
+    compressed protobuf. Byte 0 can not start serialized protobuf message (field number 0 is
+    invalid), so compressed and plain payloads are distinguished per message and plain payloads
+    of old Module gateways are passed unchanged.
+
+    Compression is negotiated by the Connect message. Module gateway supporting compression
+    sends Connect compressed by the algorithm it prefers and the server compresses messages
+    to the session by the same algorithm. Sessions with plain Connect get plain messages.
+
+    Received payloads decompressed to more than MAX_DECOMPRESSED_PAYLOAD_SIZE bytes can not be
+    decoded, every algorithm stops decompression at the limit.
+
+    Args:
+    - enabled (bool): If False, outgoing payloads are never compressed. Compressed received
+        payloads are always decompressed.
+    - threshold (int): Outgoing payloads shorter than threshold bytes are not compressed.
+    - dictionary (bytes | None): Dictionary shared with Module gateways, e.g. trained on fleet
+        messages by `zstd --train`. All algorithms use the same dictionary.
+    - labels: Labels of the codec metrics.
+    """
+
+    MARKER = 0x00
+    LEVEL = 3
+    MAX_DECOMPRESSED_SIZE = constants.MAX_DECOMPRESSED_PAYLOAD_SIZE
+
+    def __init__(
+        self, enabled: bool = False, threshold: int = 0, dictionary: bytes | None = None, **labels: str
+    ) -> None:
+        self._enabled = enabled
+        self._threshold = threshold
+        self._compressors: dict[Compression, Callable[[bytes], bytes]] = dict()
+        self._decompressors: dict[Compression, Callable[[bytes], bytes]] = dict()
+        self._init_zlib(dictionary)
+        if zstandard is not None:
+            self._init_zstd(dictionary)
+        if lz4 is not None:
+            self._init_lz4(dictionary)
+
+        registry = MetricsRegistry()
+        self._ratio = registry.histogram(
+            "external_server_payload_compression_ratio",
+            "Ratio of compressed and original size of compressed outgoing payloads",
+            **labels,
+        )
+        self._compress_seconds = registry.histogram(
+            "external_server_payload_codec_cpu_seconds",
+            "CPU time of payload compression and decompression",
+            operation="compress",
+            **labels,
+        )
+        self._decompress_seconds = registry.histogram(
+            "external_server_payload_codec_cpu_seconds",
+            "CPU time of payload compression and decompression",
+            operation="decompress",
+            **labels,
+        )
+
+    def _init_zlib(self, dictionary: bytes | None) -> None:
+        def compress(payload: bytes) -> bytes:
+            compressor = zlib.compressobj(self.LEVEL, zdict=dictionary) if dictionary else zlib.compressobj(self.LEVEL)
+            return compressor.compress(payload) + compressor.flush()
+
+        def decompress(payload: bytes) -> bytes:
+            decompressor = zlib.decompressobj(zdict=dictionary) if dictionary else zlib.decompressobj()
+            # One byte over the limit tells too large payload from payload of exactly the limit
+            decompressed = decompressor.decompress(payload, self.MAX_DECOMPRESSED_SIZE + 1)
+            if len(decompressed) > self.MAX_DECOMPRESSED_SIZE:
+                self._raise_too_large()
+            return decompressed + decompressor.flush()
+
+        self._compressors[Compression.ZLIB] = compress
+        self._decompressors[Compression.ZLIB] = decompress
+
+    def _init_zstd(self, dictionary: bytes | None) -> None:
+        dict_data = zstandard.ZstdCompressionDict(dictionary) if dictionary else None
+        # Zstd contexts are not thread safe, codec is shared by MQTT thread and threads of all cars
+        contexts = threading.local()
+
+        def compress(payload: bytes) -> bytes:
+            if not hasattr(contexts, "compressor"):
+                contexts.compressor = zstandard.ZstdCompressor(level=self.LEVEL, dict_data=dict_data)
+            return contexts.compressor.compress(payload)
+
+        def decompress(payload: bytes) -> bytes:
+            if not hasattr(contexts, "decompressor"):
+                contexts.decompressor = zstandard.ZstdDecompressor(dict_data=dict_data)
+            # Output of frame with content size is allocated by the size, max_output_size bounds only frames without it
+            if zstandard.frame_content_size(payload) > self.MAX_DECOMPRESSED_SIZE:
+                self._raise_too_large()
+            return contexts.decompressor.decompress(payload, max_output_size=self.MAX_DECOMPRESSED_SIZE)
+
+        self._compressors[Compression.ZSTD] = compress
+        self._decompressors[Compression.ZSTD] = decompress
+
+    def _init_lz4(self, dictionary: bytes | None) -> None:
+        dict_arg = {"dict": dictionary} if dictionary else {}
+
+        def decompress(payload: bytes) -> bytes:
+            # Block starts with its uncompressed size, output is allocated by it
+            uncompressed_size = int.from_bytes(payload[:4], "little")
+            if uncompressed_size > self.MAX_DECOMPRESSED_SIZE:
+                self._raise_too_large()
+            return lz4.block.decompress(payload[4:], uncompressed_size=uncompressed_size, **dict_arg)
+
+        self._compressors[Compression.LZ4] = lambda payload: lz4.block.compress(payload, **dict_arg)
+        self._decompressors[Compression.LZ4] = decompress
+
+    def _raise_too_large(self) -> None:
+        raise PayloadDecodeError(f"Decompressed payload exceeds {self.MAX_DECOMPRESSED_SIZE} bytes")
+
+    def negotiate(self, peer_compression: Compression) -> Compression:
+        """Returns compression to be used for the session, which Connect was compressed by peer_compression."""
+        if not self._enabled or peer_compression not in self._compressors:
+            return Compression.NONE
+        return peer_compression
+
+    def encode(self, payload: bytes, compression: Compression) -> bytes:
+        """Returns payload compressed by negotiated compression, unchanged payload if it is too short."""
+        if compression == Compression.NONE or len(payload) < self._threshold:
+            return payload
+        start = time.thread_time()
+        compressed = self._compressors[compression](payload)
+        self._compress_seconds.observe(time.thread_time() - start)
+        if len(compressed) + 2 >= len(payload):
+            return payload
+        self._ratio.observe((len(compressed) + 2) / len(payload))
+        return bytes((self.MARKER, compression)) + compressed
+
+    def decode(self, payload: bytes) -> tuple[bytes, Compression]:
+        """Returns serialized protobuf from received payload and compression the payload was compressed by
+
+        Raises:
+        - PayloadDecodeError: If the payload is compressed by unknown algorithm, can not be decompressed
+            or is decompressed to more than MAX_DECOMPRESSED_SIZE bytes.
+        """
+        if not payload or payload[0] != self.MARKER:
+            return payload, Compression.NONE
+        try:
+            compression = Compression(payload[1])
+            decompress = self._decompressors[compression]
+        except (IndexError, ValueError, KeyError):
+            raise PayloadDecodeError("Payload is compressed by unsupported algorithm") from None
+        start = time.thread_time()
+        try:
+            decompressed = decompress(payload[2:])
+        except PayloadDecodeError:
+            raise
+        except Exception as e:
+            raise PayloadDecodeError(f"Payload could not be decompressed by {compression.name}: {e}") from None
+        self._decompress_seconds.observe(time.thread_time() - start)
+        return decompressed, compression
+
+
+def create_payload_codec(config: Config, **labels: str) -> PayloadCodec:
+    """Creates codec with compression options from config, dictionary is read from the configured file."""
+    dictionary = None
+    if config.payload_compression_dictionary is not None:
+        with open(config.payload_compression_dictionary, "rb") as dictionary_file:
+            dictionary = dictionary_file.read()
+    return PayloadCodec(config.payload_compression, config.payload_compression_threshold, dictionary, **labels)
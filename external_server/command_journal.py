@@ -0,0 +1,245 @@
+import logging
+import mmap
+import os
+import re
+import struct
+import sys
+from pathlib import Path
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+from external_server import constants
+
+
+# Record header: kind, message counter of the command (recovery id of carried command), length of serialized command
+_HEADER = struct.Struct("<BxxxII")
+_END = 0
+_COMMAND = 1
+_ACK = 2
+# Command recovered from previous run, which has not been acknowledged after it was sent again
+_CARRIED = 3
+_CARRIED_ACK = 4
+
+_SEGMENT_NAME = re.compile(r"^segment-(\d+)\.journal$")
+
+
+class CommandJournal:
+    """Append-only journal of sent commands, which have not been acknowledged by Command response
+
+    Every session writes its own segment file, which is mapped to memory, so appending a record
+    is a copy to the mapping without a system call. Record is committed by writing its kind last,
+    a record cut by crash of the process is ignored when the segment is read. Sent commands and
+    their acknowledgements are appended to the segment. Once every command of the segment is
+    acknowledged, writing continues from the start of the segment. Full segment is compacted to
+    not acknowledged commands, written to a new file which replaces the segment, and grown if
+    more than half of it would be used.
+
+    Segments left in the directory by previous run of External server are read when the journal
+    is created and their not acknowledged commands are returned by recovered_commands. Reading is
+    linear in size of the segments, which bounds the recovery time. Recovered commands are carried
+    to the start of every following segment, until the command sent again is acknowledged, so they
+    are kept when a session fails or their device is not connected. Segments of previous run are
+    deleted once the recovered commands are carried to a new segment.
+
+    Written records are in the page cache, so they survive crash of the process, but not crash of the
+    operating system.
+
+    Args:
+    - directory (Path): Directory of segments, created if it does not exist. Every car needs its own.
+    - segment_size (int): Initial size of segment file in bytes.
+    """
+
+    def __init__(self, directory: Path, segment_size: int = constants.COMMAND_JOURNAL_SEGMENT_SIZE) -> None:
+        self._logger = logging.getLogger(self.__class__.__name__)
+        self._directory = directory
+        self._segment_size = segment_size
+        self._directory.mkdir(parents=True, exist_ok=True)
+        self._path: Path | None = None
+        self._file = None
+        self._map: mmap.mmap | None = None
+        self._offset = 0
+        # Payload offset and length of not acknowledged records in the segment by record kind and counter
+        self._commands: dict[tuple[int, int], tuple[int, int]] = dict()
+        # Segment is open, but it holds only carried commands, not commands of a session
+        self._session_started = False
+
+        self._recovered_paths = sorted(
+            (path for path in directory.iterdir() if _SEGMENT_NAME.match(path.name)),
+            key=lambda path: int(_SEGMENT_NAME.match(path.name).group(1)),
+        )
+        self._next_segment = (
+            int(_SEGMENT_NAME.match(self._recovered_paths[-1].name).group(1)) + 1 if self._recovered_paths else 0
+        )
+        recovered: list[external_protocol.Command] = []
+        for path in self._recovered_paths:
+            recovered.extend(self._read_segment(path))
+        # Not acknowledged recovered commands by recovery id
+        self._recovered: dict[int, external_protocol.Command] = dict(enumerate(recovered))
+        # Recovery ids of recovered commands sent in the current session by message counter
+        self._replayed: dict[int, int] = dict()
+        if self._recovered:
+            self._logger.warning(
+                f"{len(self._recovered)} not acknowledged commands recovered from {len(self._recovered_paths)} segments"
+            )
+
+    def _read_segment(self, path: Path) -> list[external_protocol.Command]:
+        data = path.read_bytes()
+        payloads: dict[tuple[int, int], bytes] = dict()
+        offset = 0
+        while offset + _HEADER.size <= len(data):
+            kind, counter, length = _HEADER.unpack_from(data, offset)
+            end = offset + _HEADER.size + length
+            if kind == _END or end > len(data):
+                break
+            if kind == _COMMAND or kind == _CARRIED:
+                payloads[kind, counter] = data[offset + _HEADER.size : end]
+            elif kind == _ACK:
+                payloads.pop((_COMMAND, counter), None)
+            elif kind == _CARRIED_ACK:
+                payloads.pop((_CARRIED, counter), None)
+            else:
+                self._logger.error(f"Segment {path} contains invalid record, rest of the segment is ignored")
+                break
+            offset = end
+        commands = []
+        for payload in payloads.values():
+            try:
+                commands.append(external_protocol.Command.FromString(payload))
+            except Exception as e:
+                self._logger.error(f"Segment {path} contains invalid command, the command is ignored: {e}")
+        return commands
+
+    def recovered_commands(self) -> dict[int, external_protocol.Command]:
+        """Returns commands not acknowledged in previous run of External server by their recovery id,
+        in order of sending. Command stays recovered until it is sent again and acknowledged."""
+        return self._recovered
+
+    def replayed(self, recovery_id: int, message_counter: int) -> None:
+        """Marks recovered command sent again in the current session with message_counter. The command
+        is not appended, its carried record is acknowledged by ack of message_counter."""
+        if recovery_id in self._recovered:
+            self._replayed[message_counter] = recovery_id
+
+    def start_session(self) -> None:
+        """Starts new segment, to which commands of the session are appended."""
+        self.end_session()
+        if self._map is None:
+            self._open_segment()
+        self._session_started = True
+        # Recovered commands are carried in the new segment
+        for path in self._recovered_paths:
+            path.unlink(missing_ok=True)
+        self._recovered_paths = []
+
+    def end_session(self) -> None:
+        """Deletes segment of the current session, as its commands will not be acknowledged anymore.
+        Recovered commands are carried to a new segment, which is used by the next session."""
+        if not self._session_started:
+            return
+        self._session_started = False
+        self._replayed.clear()
+        path = self._path
+        self.close()
+        if self._recovered:
+            self._open_segment()
+        path.unlink(missing_ok=True)
+        if not self._recovered:
+            self._path = None
+
+    def _open_segment(self) -> None:
+        """Opens new segment starting with carried recovered commands."""
+        self._path = self._directory / f"segment-{self._next_segment}.journal"
+        self._next_segment += 1
+        self._open(self._path, self._segment_size)
+        for recovery_id, command in self._recovered.items():
+            payload = command.SerializeToString()
+            self._commands[_CARRIED, recovery_id] = (self._append(_CARRIED, recovery_id, payload), len(payload))
+
+    def close(self) -> None:
+        """Closes segment of the current session, the segment is kept."""
+        if self._map is not None:
+            self._map.close()
+            self._file.close()
+            self._map = None
+            self._file = None
+        self._offset = 0
+        self._commands.clear()
+
+    def append(self, command: external_protocol.Command) -> None:
+        """Appends sent command to the segment of the current session."""
+        if self._map is None or not self._session_started:
+            return
+        payload = command.SerializeToString()
+        self._commands[_COMMAND, command.messageCounter] = (
+            self._append(_COMMAND, command.messageCounter, payload),
+            len(payload),
+        )
+
+    def ack(self, message_counter: int) -> None:
+        """Marks command acknowledged, unknown counters are ignored."""
+        if self._map is None or not self._session_started:
+            return
+        recovery_id = self._replayed.pop(message_counter, None)
+        if recovery_id is not None:
+            del self._recovered[recovery_id]
+            self._remove_record(_CARRIED, recovery_id, _CARRIED_ACK)
+        else:
+            self._remove_record(_COMMAND, message_counter, _ACK)
+
+    def _remove_record(self, kind: int, counter: int, ack_kind: int) -> None:
+        if self._commands.pop((kind, counter), None) is None:
+            return
+        if self._commands:
+            self._append(ack_kind, counter, b"")
+        else:
+            # Nothing to keep, segment is reused from its start
+            self._map[0] = _END
+            self._offset = 0
+
+    def _append(self, kind: int, counter: int, payload: bytes) -> int:
+        """Writes record and returns offset of its payload."""
+        size = _HEADER.size + len(payload)
+        # One byte after the record is reserved for end mark
+        if self._offset + size + 1 > len(self._map):
+            self._compact(size + 1)
+        offset = self._offset
+        end = offset + size
+        self._map[offset + _HEADER.size : end] = payload
+        # Records after the end mark may be left from before the segment was reused
+        self._map[end] = _END
+        _HEADER.pack_into(self._map, offset, _END, counter, len(payload))
+        self._map[offset] = kind
+        self._offset = end
+        return offset + _HEADER.size
+
+    def _compact(self, required: int) -> None:
+        """Rewrites the segment with not acknowledged commands only, so that required bytes are free."""
+        records = [(key, self._map[offset : offset + length]) for key, (offset, length) in self._commands.items()]
+        used = sum(_HEADER.size + len(payload) for _, payload in records) + required
+        size = len(self._map)
+        while used > size // 2:
+            size *= 2
+        if size != len(self._map):
+            self._logger.info(f"Command journal segment grown to {size} bytes")
+
+        data = bytearray()
+        commands = dict()
+        for (kind, counter), payload in records:
+            commands[kind, counter] = (len(data) + _HEADER.size, len(payload))
+            data += _HEADER.pack(kind, counter, len(payload)) + payload
+        compacted_path = self._path.with_suffix(".compacted")
+        with open(compacted_path, "wb") as compacted:
+            compacted.write(data)
+            compacted.truncate(size)
+        self.close()
+        os.replace(compacted_path, self._path)
+        self._open(self._path, size)
+        self._offset = len(data)
+        self._commands = commands
+
+    def _open(self, path: Path, size: int) -> None:
+        self._file = open(path, "a+b")
+        if os.fstat(self._file.fileno()).st_size < size:
+            self._file.truncate(size)
+        self._map = mmap.mmap(self._file.fileno(), size)
@@ -1,45 +1,81 @@
+import itertools
 import threading
-from queue import Queue, Empty
+import time
+from collections import deque
 import logging
 import sys
 
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 import InternalProtocol_pb2 as internal_protocol
-from external_server.structures import GeneralErrorCodes, EsErrorCodes
+from external_server.structures import GeneralErrorCodes, EsErrorCodes, EventPriority
 from external_server.external_server_api_client import ExternalServerApiClient
-from external_server.event_queue import EventQueueSingleton, EventType
+from external_server.event_queue import EventQueue, EventQueueSingleton, EventType
 
 
 class CommandWaitingThread:
+    """Obtains commands from module API and announces them to the event queue
+
+    If the module supports command callback, commands are popped directly in the callback
+    called by the module and no thread is started. Otherwise a thread polls the module
+    by wait_for_command.
+    """
+
     TIMEOUT = 1000  # Timeout for wait_for_command in ms
 
-    def __init__(self, api_client: ExternalServerApiClient) -> None:
+    def __init__(
+        self,
+        api_client: ExternalServerApiClient,
+        event_queue: EventQueue | None = None,
+        priority: EventPriority = EventPriority.NORMAL,
+    ) -> None:
         self._logger = logging.getLogger(
             f"{self.__class__.__name__}({api_client.get_module_number()})"
         )
 
         self._api_client = api_client
-        self._event_queue = EventQueueSingleton()
+        self._event_queue = event_queue if event_queue is not None else EventQueueSingleton()
+        # Priority of command available events
+        self._priority = priority
         self._waiting_thread = threading.Thread(target=self._main_thread)
-        self._commands: Queue[tuple[bytes, internal_protocol.Device]] = Queue()
+        # Commands are saved by one producer (waiting thread or module callback) and popped by
+        # the main loop. Appending to and popping from deque are atomic, so no lock is needed.
+        # Every command is stored with generation in which it was saved and monotonic time at
+        # which it was popped from API, commands of older generations are stale and discarded.
+        self._commands: deque[tuple[int, bytes, internal_protocol.Device, float]] = deque()
+        self._generations = itertools.count()
+        self._generation = next(self._generations)
         self._connection_established = False
-        self._commands_lock = threading.Lock()
-        self._connection_established_lock = threading.Lock()
         self._continue_thread = True
 
     @property
     def connection_established(self):
-        with self._connection_established_lock:
-            return self._connection_established
+        return self._connection_established
 
     @connection_established.setter
     def connection_established(self, value: bool):
-        with self._connection_established_lock:
-            self._connection_established = value
+        if not value:
+            # Commands saved before connection dropped must not be sent
+            self._start_generation()
+        self._connection_established = value
+
+    def _start_generation(self) -> None:
+        """Makes saved commands stale and removes them, so that they are not kept while the car is offline."""
+        self._generation = next(self._generations)
+        # Commands saved concurrently with clearing are filtered by generation when popped
+        self._commands.clear()
 
     def start(self) -> None:
-        """Starts the thread for obtaining command from external server api."""
+        """Registers command callback in external server api if supported, else starts the thread
+        for obtaining command from external server api."""
+        if self._api_client.command_callback_supported:
+            rc = self._api_client.register_command_callback(self._save_available_commands)
+            if rc == GeneralErrorCodes.OK:
+                self._logger.info("Commands are announced by module callback")
+                return
+            self._logger.error(
+                f"Error occured in register_command_callback function in API, rc: {rc}, polling for commands"
+            )
         self._waiting_thread.start()
 
     def stop(self) -> None:
@@ -51,15 +87,32 @@ class CommandWaitingThread:
         if self._waiting_thread.is_alive():
             self._waiting_thread.join()
 
-    def pop_command(self) -> tuple[internal_protocol.Device, bytes] | None:
+    def pop_command(self) -> tuple[bytes, internal_protocol.Device] | None:
         """Returns available command if currently available, else returns None."""
-        try:
-            with self._commands_lock:
-                command = self._commands.get(block=False)
-        except Empty:
+        command = self.pop_command_with_time()
+        if command is None:
             return None
-
-        return command
+        command_bytes, device, _ = command
+        return command_bytes, device
+
+    def pop_command_with_time(self) -> tuple[bytes, internal_protocol.Device, float] | None:
+        """Returns available command together with monotonic time at which it was popped from API,
+        returns None if no command is available."""
+        while True:
+            try:
+                generation, command_bytes, device, popped_at = self._commands.popleft()
+            except IndexError:
+                return None
+            if generation == self._generation:
+                return command_bytes, device, popped_at
+
+    def pop_commands(self) -> list[tuple[bytes, internal_protocol.Device, float]]:
+        """Returns all available commands in order in which they were popped from API, each with
+        monotonic time at which it was popped."""
+        commands = []
+        while (command := self.pop_command_with_time()) is not None:
+            commands.append(command)
+        return commands
 
     def _save_available_commands(self) -> None:
         remaining_commands = 1
@@ -71,16 +124,16 @@ class CommandWaitingThread:
                     f"Error occured in pop_command function in API, rc: {remaining_commands}"
                 )
             else:
-                with self._commands_lock:
-                    with self._connection_established_lock:
-                        if not self._connection_established:
-                            while not self._commands.empty():
-                                _ = self._commands.get()
-
-                    self._commands.put((command, device))
+                if not self._connection_established:
+                    # Previously saved commands are removed, only the latest command is kept until
+                    # connection is established
+                    self._start_generation()
+                self._commands.append((self._generation, command, device, time.monotonic()))
         if self._connection_established:
             self._event_queue.add_event(
-                event_type=EventType.COMMAND_AVAILABLE, data=self._api_client.get_module_number()
+                event_type=EventType.COMMAND_AVAILABLE,
+                data=self._api_client.get_module_number(),
+                priority=self._priority,
             )
 
     def _main_thread(self) -> None:
@@ -1,9 +1,22 @@
 from __future__ import annotations
 import json
 
-from typing import Annotated, TypeVar, Mapping
+from pathlib import Path
+from typing import Annotated, Literal, TypeVar, Mapping
 
-from pydantic import BaseModel, Field, FilePath, StringConstraints, ValidationError, field_validator, DirectoryPath
+from pydantic import (
+    BaseModel,
+    Field,
+    FilePath,
+    StringConstraints,
+    ValidationError,
+    field_validator,
+    model_validator,
+    DirectoryPath,
+)
+
+from external_server import constants
+from external_server.structures import Backpressure, EventPriority, ThreadSafety, TransportType
 
 T = TypeVar("T", bound=Mapping)
 
@@ -14,14 +27,41 @@ class Config(BaseModel):
     mqtt_address: Annotated[str, StringConstraints(pattern=r"^((http|https)://)?([\w-]+\.)?+[\w-]+$")]
     mqtt_port: int = Field(ge=0, le=65535)
     mqtt_timeout: int = Field(ge=0)
+    mqtt_max_queued_messages: int = Field(default=constants.MAX_QUEUED_MESSAGES, ge=0)
+    mqtt_max_inflight_messages: int = Field(default=constants.MAX_INFLIGHT_MESSAGES, ge=1)
+    mqtt_adaptive_queue: bool = False
+    transport: TransportType = TransportType.MQTT
+    unix_socket_path: Path | None = None
     timeout: int = Field(ge=0)
     send_invalid_command: bool
     sleep_duration_after_connection_refused: float = Field(ge=0)
+    session_resume_grace_period: float = Field(default=0, ge=0)
+    cumulative_status_ack_interval: float = Field(default=0, ge=0)
     log_files_directory: DirectoryPath
     log_files_to_keep: int = Field(ge=0)
     log_file_max_size_bytes: int = Field(ge=0)
+    log_async: bool = False
+    log_format: Literal["rich", "json"] = "rich"
+    log_sampling: dict[str, Annotated[int, Field(ge=1)]] = dict()
+    multi_car: bool = False
+    multi_car_max_cars: int = Field(default=0, ge=0)
+    multi_car_allowed_cars: list[Annotated[str, StringConstraints(pattern=r"^[a-z0-9_]*$")]] | None = None
+    metrics_port: int | None = Field(default=None, ge=0, le=65535)
+    payload_compression: bool = False
+    payload_compression_threshold: int = Field(default=512, ge=0)
+    payload_compression_dictionary: FilePath | None = None
+    command_journal_directory: DirectoryPath | None = None
+    command_journal_segment_size: int = Field(default=constants.COMMAND_JOURNAL_SEGMENT_SIZE, ge=1)
     modules: dict[Annotated[str, StringConstraints(pattern=r"^\d+$")], ModuleConfig]
 
+    @field_validator("log_sampling")
+    @classmethod
+    def _log_sampling_validator(cls, log_sampling: T) -> T:
+        for category in log_sampling:
+            if category not in constants.LOG_CATEGORIES:
+                raise ValueError(f"Log sampling category must be one of {', '.join(constants.LOG_CATEGORIES)}.")
+        return log_sampling
+
     @field_validator("modules")
     @classmethod
     def _modules_validator(cls, modules: T) -> T:
@@ -33,6 +73,15 @@ class Config(BaseModel):
             if module.config.get("car_name") is not None:
                 raise ValueError("Module configs can not contain car_name.")
         return modules
+
+    @model_validator(mode="after")
+    def _transport_validator(self) -> Config:
+        if self.transport == TransportType.UNIX_SOCKET:
+            if self.unix_socket_path is None:
+                raise ValueError("Unix socket transport requires unix_socket_path.")
+            if self.multi_car:
+                raise ValueError("Unix socket transport can not be used in multi-car mode.")
+        return self
     
     def get_config_dump_string(self) -> str:
         """Returns a string representation of the config. Values need to be added explicitly."""
@@ -42,22 +91,66 @@ class Config(BaseModel):
         config_json["mqtt_address"] = self.mqtt_address
         config_json["mqtt_port"] = self.mqtt_port
         config_json["mqtt_timeout"] = self.mqtt_timeout
+        config_json["mqtt_max_queued_messages"] = self.mqtt_max_queued_messages
+        config_json["mqtt_max_inflight_messages"] = self.mqtt_max_inflight_messages
+        config_json["mqtt_adaptive_queue"] = self.mqtt_adaptive_queue
+        config_json["transport"] = self.transport.value
+        config_json["unix_socket_path"] = str(self.unix_socket_path) if self.unix_socket_path is not None else None
         config_json["timeout"] = self.timeout
         config_json["send_invalid_command"] = self.send_invalid_command
         config_json["sleep_duration_after_connection_refused"] = self.sleep_duration_after_connection_refused
+        config_json["session_resume_grace_period"] = self.session_resume_grace_period
+        config_json["cumulative_status_ack_interval"] = self.cumulative_status_ack_interval
         config_json["log_files_directory"] = str(self.log_files_directory)
         config_json["log_files_to_keep"] = self.log_files_to_keep
         config_json["log_file_max_size_bytes"] = self.log_file_max_size_bytes
+        config_json["log_async"] = self.log_async
+        config_json["log_format"] = self.log_format
+        config_json["log_sampling"] = self.log_sampling
+        config_json["multi_car"] = self.multi_car
+        config_json["multi_car_max_cars"] = self.multi_car_max_cars
+        config_json["multi_car_allowed_cars"] = self.multi_car_allowed_cars
+        config_json["metrics_port"] = self.metrics_port
+        config_json["payload_compression"] = self.payload_compression
+        config_json["payload_compression_threshold"] = self.payload_compression_threshold
+        config_json["payload_compression_dictionary"] = (
+            str(self.payload_compression_dictionary) if self.payload_compression_dictionary is not None else None
+        )
+        config_json["command_journal_directory"] = (
+            str(self.command_journal_directory) if self.command_journal_directory is not None else None
+        )
+        config_json["command_journal_segment_size"] = self.command_journal_segment_size
         
         module_json = {}
         for key, value in self.modules.items():
-            module_json[key] = {"lib_path": str(value.lib_path), "config": "HIDDEN"}
+            module_json[key] = {
+                "lib_path": str(value.lib_path),
+                "coalesce_commands": value.coalesce_commands,
+                "queue_size": value.queue_size,
+                "backpressure": value.backpressure.value,
+                "thread_safety": value.thread_safety.value if value.thread_safety is not None else None,
+                "deduplicate_statuses": value.deduplicate_statuses,
+                "min_status_interval": value.min_status_interval,
+                "priority": value.priority.value,
+                "device_type_priorities": {
+                    device_type: priority.value for device_type, priority in value.device_type_priorities.items()
+                },
+                "config": "HIDDEN",
+            }
         config_json["modules"] = module_json
 
         return json.dumps(config_json, indent=4)
 
 class ModuleConfig(BaseModel):
     lib_path: FilePath
+    coalesce_commands: bool = False
+    queue_size: int = Field(default=constants.MODULE_QUEUE_SIZE, ge=1)
+    backpressure: Backpressure = Backpressure.BLOCK
+    thread_safety: ThreadSafety | None = None
+    deduplicate_statuses: bool = False
+    min_status_interval: float = Field(default=0, ge=0)
+    priority: EventPriority = EventPriority.NORMAL
+    device_type_priorities: dict[int, EventPriority] = dict()
     config: dict[str, str]
 
 
@@ -1,7 +1,24 @@
-# maximum number of messages in outgoing queue
+# default maximum number of messages in outgoing queue
 # value reasoning: external server can handle cca 20 devices
 MAX_QUEUED_MESSAGES = 20
 
+# default maximum number of QoS 1 messages waiting for acknowledgement from broker
+# value reasoning: same as default of paho mqtt client
+MAX_INFLIGHT_MESSAGES = 20
+
+# outgoing queue size per connected device if adaptive queue is enabled
+# value reasoning: connect sequence sends status response and command to every device at once,
+# the rest is reserve for statuses and commands sent while broker does not acknowledge messages
+QUEUED_MESSAGES_PER_DEVICE = 4
+
+# in-flight window per connected device if adaptive queue is enabled
+INFLIGHT_MESSAGES_PER_DEVICE = 2
+
+# default maximum number of API calls waiting in dispatch queue of a module
+# value reasoning: statuses are forwarded in batches, so the queue covers several seconds
+# of statuses of all devices of the module
+MODULE_QUEUE_SIZE = 100
+
 # value reasoning: keepalive is half of the default timeout in Fleet protocol (30 s)
 KEEPALIVE = 15
 
@@ -12,4 +29,31 @@ QOS = 1
 LOG_FILE_NAME = "external_server.log"
 
 # Log file format
-LOG_FORMAT = "%(asctime)s - %(levelname)s - %(message)s"
\ No newline at end of file
+LOG_FORMAT = "%(asctime)s - %(levelname)s - %(message)s"
+
+# Categories of per-message logs, which can be sampled by log_sampling
+LOG_CATEGORIES = ("status", "status_response", "command", "command_response")
+
+# default initial size of command journal segment in bytes
+# value reasoning: holds thousands of not acknowledged commands of usual size before compaction
+COMMAND_JOURNAL_SEGMENT_SIZE = 1024 * 1024
+
+# number of high priority events taken from event queue in a row, after which a waiting normal event is taken
+# value reasoning: normal events wait for at most 8 high events, high events are rare and quick to handle
+HIGH_PRIORITY_EVENT_BURST = 8
+
+# maximum size of decompressed received payload in bytes, larger payloads are dropped
+# value reasoning: far above any Fleet protocol message, bounds memory used by a malicious compressed payload
+MAX_DECOMPRESSED_PAYLOAD_SIZE = 16 * 1024 * 1024
+
+# maximum size of message received on Unix socket in bytes, larger size means corrupted stream
+# value reasoning: far above any Fleet protocol message, small enough to not exhaust memory
+UNIX_SOCKET_MAX_MESSAGE_SIZE = 16 * 1024 * 1024
+
+# timeout of sending message to module gateway on Unix socket in seconds, connection is closed after it
+# value reasoning: module gateway on the same host reads continuously, same as MQTT keepalive
+UNIX_SOCKET_SEND_TIMEOUT = KEEPALIVE
+
+# number of refused car names remembered in multi-car mode, refusal is logged once per remembered name
+# value reasoning: bounds memory used by messages with random car names, repeated refusals are not logged
+MAX_REFUSED_CARS_LOGGED = 1024
@@ -0,0 +1,72 @@
+import sys
+from typing import Iterator
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import InternalProtocol_pb2 as internal_protocol
+from external_server.structures import DeviceIdentificationPython
+
+
+class DeviceRegistry:
+    """Set of devices with constant time membership checks
+
+    Devices are identified by module, device type and device role, same as
+    DeviceIdentificationPython equality. Registry also keeps number of registered
+    devices of every module.
+    """
+
+    __slots__ = ("_devices", "_module_device_counts")
+
+    def __init__(self) -> None:
+        self._devices: dict[tuple[int, int, str], DeviceIdentificationPython] = dict()
+        self._module_device_counts: dict[int, int] = dict()
+
+    @staticmethod
+    def key(device: internal_protocol.Device) -> tuple[int, int, str]:
+        """Returns key identifying the device, same for devices equal by DeviceIdentificationPython equality."""
+        return device.module, device.deviceType, device.deviceRole
+
+    def add(self, device: internal_protocol.Device) -> bool:
+        """Adds device to registry, returns False if the device is already registered."""
+        key = self.key(device)
+        if key in self._devices:
+            return False
+        self._devices[key] = DeviceIdentificationPython(
+            device.module, device.deviceType, device.deviceRole, device.deviceName, device.priority
+        )
+        self._module_device_counts[device.module] = self._module_device_counts.get(device.module, 0) + 1
+        return True
+
+    def remove(self, device: internal_protocol.Device) -> bool:
+        """Removes device from registry, returns False if the device is not registered."""
+        if self._devices.pop(self.key(device), None) is None:
+            return False
+        count = self._module_device_counts[device.module] - 1
+        if count:
+            self._module_device_counts[device.module] = count
+        else:
+            del self._module_device_counts[device.module]
+        return True
+
+    def module_device_count(self, module: int) -> int:
+        """Returns number of registered devices of given module."""
+        return self._module_device_counts.get(module, 0)
+
+    def copy(self) -> "DeviceRegistry":
+        registry = DeviceRegistry()
+        registry._devices = self._devices.copy()
+        registry._module_device_counts = self._module_device_counts.copy()
+        return registry
+
+    def clear(self) -> None:
+        self._devices.clear()
+        self._module_device_counts.clear()
+
+    def __contains__(self, device: internal_protocol.Device) -> bool:
+        return self.key(device) in self._devices
+
+    def __iter__(self) -> Iterator[DeviceIdentificationPython]:
+        return iter(list(self._devices.values()))
+
+    def __len__(self) -> int:
+        return len(self._devices)
@@ -1,36 +1,131 @@
+import collections
 import queue
+import threading
+import time
 from typing import Any
 from dataclasses import dataclass
 from enum import Enum, auto
 
+from external_server import constants
+from external_server.metrics import Histogram, MetricsRegistry
+from external_server.structures import EventPriority
 from external_server.utils import SingletonMeta
 
 
 class EventType(Enum):
     COMMAND_AVAILABLE = auto()  # data = module number
-    RECEIVED_MESSAGE = auto()
+    RECEIVED_MESSAGE = auto()  # data = (received message, monotonic time of its reception, negotiated compression)
     MQTT_BROKER_DISCONNECTED = auto()
     TIMEOUT_OCCURRED = auto()  # data = TimeoutType
+    STATUS_ACK_FLUSH = auto()
+    STATUS_FILTER_FLUSH = auto()
+    MODULES_RELOAD = auto()
+    MODULES_RELOAD_READY = auto()
 
 
 @dataclass(slots=True)
 class Event:
     event: EventType
     data: Any | None = None
+    priority: EventPriority = EventPriority.NORMAL
+    # Monotonic time at which the event was added to the queue
+    queued_at: float = 0.0
 
 
-class EventQueueSingleton(metaclass=SingletonMeta):
-    __slots__ = "_queue"
+class EventQueue:
+    """Queue of events processed by the External server main loop
+
+    Received messages are carried by RECEIVED_MESSAGE events, so every message is passed
+    from MQTT client thread to the main loop through this queue only.
+
+    Events of HIGH priority are taken before NORMAL events, events of the same priority in order
+    of adding. So that normal events are not starved, one normal event is taken after every
+    HIGH_PRIORITY_EVENT_BURST high events taken while normal events were waiting. Received
+    messages and timeouts are normal events, their order must not change (statuses and command
+    responses have to be handled in order of reception and before later timeouts).
+    """
+
+    __slots__ = ("_queues", "_condition", "_high_in_row", "_delays")
 
     def __init__(self) -> None:
-        self._queue = queue.Queue()
+        self._queues: dict[EventPriority, collections.deque[Event]] = {
+            EventPriority.HIGH: collections.deque(),
+            EventPriority.NORMAL: collections.deque(),
+        }
+        self._condition = threading.Condition()
+        # Number of high events taken in a row while normal events were waiting
+        self._high_in_row = 0
+        self._delays: dict[EventPriority, Histogram] | None = None
+
+    def register_metrics(self, **labels: str) -> None:
+        """Records time, which events spend in the queue, to histograms labelled with priority."""
+        registry = MetricsRegistry()
+        self._delays = {
+            priority: registry.histogram(
+                "external_server_event_queue_delay_seconds",
+                "Time between adding event to event queue and taking it by main loop",
+                priority=priority.value,
+                **labels,
+            )
+            for priority in EventPriority
+        }
+
+    def add_event(
+        self, event_type: EventType, data: Any | None = None, priority: EventPriority = EventPriority.NORMAL
+    ) -> None:
+        event = Event(event_type, data, priority, time.monotonic())
+        with self._condition:
+            self._queues[priority].append(event)
+            self._condition.notify()
+
+    def get(self, block: bool = True, timeout: float | None = None) -> Event:
+        """Returns the next event, same as queue.Queue.get; raises queue.Empty if no event is
+        available without blocking or in timeout seconds."""
+        with self._condition:
+            if not self._condition.wait_for(self.qsize, timeout if block else 0):
+                raise queue.Empty
+            event = self._pop()
+        if self._delays is not None:
+            self._delays[event.priority].observe(time.monotonic() - event.queued_at)
+        return event
+
+    def _pop(self) -> Event:
+        high = self._queues[EventPriority.HIGH]
+        normal = self._queues[EventPriority.NORMAL]
+        if high and not (normal and self._high_in_row >= constants.HIGH_PRIORITY_EVENT_BURST):
+            self._high_in_row = self._high_in_row + 1 if normal else 0
+            return high.popleft()
+        self._high_in_row = 0
+        return normal.popleft()
+
+    def get_received_message(self, timeout: float | None = None) -> Event | None:
+        """Returns next RECEIVED_MESSAGE or MQTT_BROKER_DISCONNECTED event, other events are dropped.
+        Returns None if no such event is added in timeout seconds, blocks if timeout is None."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while True:
+            remaining = None if deadline is None else max(0.0, deadline - time.monotonic())
+            try:
+                event = self.get(timeout=remaining)
+            except queue.Empty:
+                return None
+            if event.event in (EventType.RECEIVED_MESSAGE, EventType.MQTT_BROKER_DISCONNECTED):
+                return event
+
+    def qsize(self) -> int:
+        """Returns number of events waiting in the queue."""
+        return len(self._queues[EventPriority.HIGH]) + len(self._queues[EventPriority.NORMAL])
+
+    def clear(self, keep: tuple[EventType, ...] = ()) -> None:
+        """Drops waiting events, events of types in keep stay in the queue in their order."""
+        with self._condition:
+            for events in self._queues.values():
+                kept = [event for event in events if event.event in keep]
+                events.clear()
+                events.extend(kept)
+            self._high_in_row = 0
 
-    def add_event(self, event_type: EventType, data: Any | None = None) -> None:
-        self._queue.put(Event(event=event_type, data=data))
 
-    def get(self, *args, **kwargs) -> Event:
-        return self._queue.get(*args, **kwargs)
+class EventQueueSingleton(EventQueue, metaclass=SingletonMeta):
+    """Event queue shared by all components of a single car External server."""
 
-    def clear(self) -> None:
-        while self._queue.qsize():
-            _ = self._queue.get()
+    __slots__ = ()
@@ -9,6 +9,19 @@ class CommunicationException(Exception):
     pass
 
 
+class PayloadDecodeError(Exception):
+    pass
+
+
+class ModuleInitError(RuntimeError):
+    pass
+
+
+class BrokerDisconnectedExc(CommunicationException):
+    def __init__(self) -> None:
+        super().__init__("Connection to MQTT broker has been lost")
+
+
 class ClientDisconnectedExc(CommunicationException):
     def __init__(self):
         super().__init__("Unexpected disconnection")
@@ -1,68 +1,458 @@
 import logging
+import threading
 import time
 import sys
+from concurrent.futures import Future, ThreadPoolExecutor, wait
+from pathlib import Path
+from typing import Callable
 
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 import ExternalProtocol_pb2 as external_protocol
 import InternalProtocol_pb2 as internal_protocol
-from external_server.checker import CommandMessagesChecker, SessionTimeoutChecker, OrderChecker
+from external_server.checker import (
+    CommandMessagesChecker,
+    Deadline,
+    DeadlineScheduler,
+    SessionTimeoutChecker,
+    OrderChecker,
+)
+from external_server.codec import create_payload_codec
+from external_server.command_journal import CommandJournal
 from external_server.exceptions import (
     ConnectSequenceException,
     CommunicationException,
     StatusTimeOutExc,
+    BrokerDisconnectedExc,
     ClientDisconnectedExc,
     CommandResponseTimeOutExc,
+    ModuleInitError,
 )
-from external_server.message_creator import MessageCreator
+from external_server.message_creator import MessageCreator, StatusResponseSerializer
 from external_server.mqtt_client import MqttClient
+from external_server.transport import Transport
+from external_server.unix_socket_client import UnixSocketClient
 from external_server.utils import check_file_exists, device_repr
 from external_server.external_server_api_client import ExternalServerApiClient
 from external_server.command_waiting_thread import CommandWaitingThread
-from external_server.config import Config
-from external_server.structures import GeneralErrorCodes, DisconnectTypes, TimeoutType, DeviceIdentificationPython
-from external_server.event_queue import EventQueueSingleton, EventType
+from external_server.module_worker import ModuleWorker
+from external_server.status_filter import StatusFilter, StatusFilterSettings
+from external_server.config import Config, ModuleConfig
+from external_server.device_registry import DeviceRegistry
+from external_server.structures import (
+    GeneralErrorCodes,
+    DisconnectTypes,
+    EventPriority,
+    TimeoutType,
+    TransportType,
+    DeviceIdentificationPython,
+)
+from external_server.event_queue import EventQueue, EventQueueSingleton, EventType
+from external_server.logs import STATUS_LOG, STATUS_RESPONSE_LOG, COMMAND_LOG, COMMAND_RESPONSE_LOG
+from external_server.metrics import MetricsRegistry
 
 
 class ExternalServer:
-    def __init__(self, config: Config) -> None:
-        self._logger = logging.getLogger(self.__class__.__name__)
+    def __init__(
+        self,
+        config: Config,
+        car_name: str | None = None,
+        mqtt_client: Transport | None = None,
+        event_queue: EventQueue | None = None,
+    ) -> None:
+        """Creates External server for single car
 
-        self._config = config
-        self._session_id = ""
+        Parameters
+        ----------
+        config : Config
+            External server config
 
-        self._event_queue = EventQueueSingleton()
+        car_name : str | None
+            name of the handled car, car_name from config is used if not given
 
-        self._session_checker = SessionTimeoutChecker(self._config.mqtt_timeout)
-        self._command_checker = CommandMessagesChecker(self._config.timeout)
-        self._status_order_checker = OrderChecker(self._config.timeout)
-        self._connected_devices = list()
-        self._not_connected_devices = list()
-        self._mqtt_client = MqttClient(self._config.company_name, self._config.car_name)
+        mqtt_client : Transport | None
+            client for communication with the car in multi-car mode, own transport by config is created if not given
 
+        event_queue : EventQueue | None
+            event queue of the car in multi-car mode, EventQueueSingleton is used if not given
+        """
+        if car_name is None:
+            self._logger = logging.getLogger(self.__class__.__name__)
+            car_name = config.car_name
+        else:
+            self._logger = logging.getLogger(f"{self.__class__.__name__}({car_name})")
+
+        self._config = config
+        self._car_name = car_name
+        self._session_id = ""
+        self._running = True
+        # Monotonic time at which the session was suspended, None if there is no suspended session
+        self._session_suspended_at: float | None = None
+
+        self._event_queue = event_queue if event_queue is not None else EventQueueSingleton()
+
+        self._session_checker = SessionTimeoutChecker(self._config.mqtt_timeout, self._event_queue, self._car_name)
+        self._command_checker = CommandMessagesChecker(self._config.timeout, self._event_queue, self._car_name)
+        self._status_order_checker = OrderChecker(self._config.timeout, self._event_queue, self._car_name)
+        # Sent commands waiting for Command response are journaled, so that they are sent again after crash
+        self._command_journal = (
+            CommandJournal(
+                Path(self._config.command_journal_directory) / self._car_name, self._config.command_journal_segment_size
+            )
+            if self._config.command_journal_directory is not None
+            else None
+        )
+        self._connected_devices = DeviceRegistry()
+        self._not_connected_devices = list()
+        self._status_response_serializer = StatusResponseSerializer()
+        # Newest status waiting for cumulative Status response and deadline of the response
+        self._pending_status_ack: external_protocol.Status | None = None
+        self._status_ack_flush: Deadline | None = None
+        self._status_filter = StatusFilter(
+            {
+                int(module_number): StatusFilterSettings(module.deduplicate_statuses, module.min_status_interval)
+                for module_number, module in config.modules.items()
+            },
+            self._car_name,
+        )
+        # Deadline of the first status held by status filter
+        self._status_filter_flush: Deadline | None = None
+        self._mqtt_client: Transport = mqtt_client if mqtt_client is not None else self._create_transport()
+
+        # Configs of running modules, modules are replaced by reload_modules
+        self._module_configs: dict[int, ModuleConfig] = {
+            int(module_number): module for module_number, module in config.modules.items()
+        }
+        # Configs given to reload_modules, not yet applied by the main loop
+        self._pending_module_configs: dict[int, ModuleConfig] | None = None
+        self._pending_module_configs_lock = threading.Lock()
+        # Reload with modules being initialized in background: applied configs, removed modules
+        # and futures of loaded modules, None if no reload is in progress
+        self._module_reload: tuple[dict[int, ModuleConfig], list[int], dict[int, Future]] | None = None
         self._modules = dict()
         self._modules_command_threads = dict()
+        # API calls of every module are made by its worker, so a slow module does not block others
+        self._module_workers: dict[int, ModuleWorker] = dict()
+        self._coalescing_modules = {
+            int(module_number) for module_number, module in config.modules.items() if module.coalesce_commands
+        }
+        # Commands held back until previous command for the same device is acknowledged
+        self._held_commands: dict[tuple[int, int, str], tuple[int, bytes, internal_protocol.Device, float]] = dict()
         config_modules = config.modules
         for module_number in config_modules:
             self._modules[int(module_number)] = ExternalServerApiClient(
-                config_modules[module_number], self._config.company_name, self._config.car_name
+                config_modules[module_number], self._config.company_name, self._car_name
             )
-            self._modules[int(module_number)].init()
-            
-            if not self._modules[int(module_number)].device_initialized():
-                self._logger.error(
-                    f"Module {module_number}: Error occurred in init function. Check the configuration file."
-                )
-                raise RuntimeError(f"Module {module_number}: Error occurred in init function. Check the configuration file.")
+            self._module_workers[int(module_number)] = ModuleWorker(
+                int(module_number),
+                config_modules[module_number].queue_size,
+                config_modules[module_number].backpressure,
+                self._car_name,
+            )
+        # Modules are initialized in parallel, also with connecting to MQTT broker in start
+        self._modules_ready = False
+        module_init = ThreadPoolExecutor(max_workers=len(self._modules), thread_name_prefix="ModuleInit")
+        self._module_init: dict[int, Future] = {
+            module_number: module_init.submit(self._init_module, module_number, module)
+            for module_number, module in self._modules.items()
+        }
+        module_init.shutdown(wait=False)
+
+        # Metrics of client shared by all cars are registered by MultiCarExternalServer
+        self._owns_mqtt_client = mqtt_client is None
+        self._init_metrics()
+        if self._owns_mqtt_client:
+            # In multi-car mode readiness of the shared client is checked, cars are created on demand
+            MetricsRegistry().readiness_check(self._car_name, self._is_ready)
+
+    @staticmethod
+    def _init_module(module_number: int, module: ExternalServerApiClient) -> None:
+        module.init()
+        if not module.device_initialized():
+            raise ModuleInitError(f"Module {module_number}: Error occurred in init function. Check the configuration file.")
+        if module.get_module_number() != module_number:
+            raise ModuleInitError(
+                f"Module number {module.get_module_number()} returned from API does not match "
+                f"with module number {module_number} in config"
+            )
+
+    def wait_for_modules(self) -> None:
+        """Waits until all modules are initialized and starts their command threads and workers.
+
+        Raises:
+        - ModuleInitError: If any module could not be initialized.
+        """
+        if self._modules_ready:
+            return
+        for module_number, future in self._module_init.items():
+            try:
+                future.result()
+            except ModuleInitError as e:
+                self._logger.error(str(e))
+                raise
+            except Exception as e:
+                self._logger.error(f"Module {module_number}: Module could not be initialized: {e}")
+                raise ModuleInitError(f"Module {module_number}: Module could not be initialized: {e}") from e
+        for module_number, module in self._modules.items():
+            self._modules_command_threads[module_number] = CommandWaitingThread(
+                module, self._event_queue, self._command_event_priority(self._module_configs[module_number])
+            )
+            self._module_workers[module_number].start()
+            self._modules_command_threads[module_number].start()
+        self._modules_ready = True
+        self._logger.info("All modules have been initialized")
+
+    @staticmethod
+    def _command_event_priority(module_config: ModuleConfig) -> EventPriority:
+        """Returns priority of command available events of the module, high if any of its commands can be high."""
+        priorities = {module_config.priority, *module_config.device_type_priorities.values()}
+        return EventPriority.HIGH if EventPriority.HIGH in priorities else EventPriority.NORMAL
+
+    def _command_priority(self, module_num: int, device: internal_protocol.Device) -> EventPriority:
+        module_config = self._module_configs[module_num]
+        return module_config.device_type_priorities.get(device.deviceType, module_config.priority)
+
+    def _is_ready(self) -> bool:
+        return self._modules_ready and self._mqtt_client.is_connected
+
+    def reload_modules(self, modules: dict[str, ModuleConfig]) -> None:
+        """Requests replacement of running modules by modules from given config.
+
+        Can be called from any thread, modules are reloaded by the main loop between handling of
+        messages (see _reload_modules).
+        """
+        with self._pending_module_configs_lock:
+            self._pending_module_configs = {
+                int(module_number): module for module_number, module in modules.items()
+            }
+        self._event_queue.add_event(event_type=EventType.MODULES_RELOAD)
+
+    def _reload_modules(self) -> None:
+        """Applies module configs given to reload_modules, modules with unchanged config are not affected.
+
+        Added modules are loaded and initialized, removed modules are destroyed and their devices
+        disconnected. Module with changed config is replaced by a new instance, which is initialized
+        before the old one is destroyed. Connected devices of the module are disconnected from the old
+        instance and connected to the new one, so the session with the car goes on. If the new
+        instance can not be initialized, the old one keeps running.
+
+        Modules are initialized in background, so that messages of the session are handled meanwhile.
+        Once all of them are initialized, MODULES_RELOAD_READY event is added and the next call
+        swaps the modules. Configs given while a reload is in progress are applied after it.
+        """
+        if self._module_reload is not None:
+            if not all(future.done() for future in self._module_reload[2].values()):
+                return
+            module_reload, self._module_reload = self._module_reload, None
+            self._swap_modules(*module_reload)
+        with self._pending_module_configs_lock:
+            configs, self._pending_module_configs = self._pending_module_configs, None
+        if configs is None:
+            return
+        removed = [module_number for module_number in self._module_configs if module_number not in configs]
+        loaded = [
+            module_number
+            for module_number, module_config in configs.items()
+            if self._module_configs.get(module_number) != module_config
+        ]
+        if not removed and not loaded:
+            self._logger.info("Module configuration has not changed, no module reloaded")
+            return
+        self._logger.info(f"Reloading modules, removed: {removed}, added or changed: {loaded}")
+        if not loaded:
+            self._swap_modules(configs, removed, dict())
+            return
+
+        module_init = ThreadPoolExecutor(max_workers=len(loaded), thread_name_prefix="ModuleInit")
+        futures = {
+            module_number: module_init.submit(self._load_module, module_number, configs[module_number])
+            for module_number in loaded
+        }
+        module_init.shutdown(wait=False)
+        self._module_reload = (configs, removed, futures)
+
+        def announce_ready(_future: Future) -> None:
+            # Event may be added twice if modules finish at once, the second one finds no reload in progress
+            if all(future.done() for future in futures.values()):
+                self._event_queue.add_event(event_type=EventType.MODULES_RELOAD_READY)
+
+        for future in futures.values():
+            future.add_done_callback(announce_ready)
 
-            if self._modules[int(module_number)].get_module_number() != int(module_number):
+    def _swap_modules(
+        self, configs: dict[int, ModuleConfig], removed: list[int], futures: dict[int, Future]
+    ) -> None:
+        """Removes modules and replaces running modules by initialized ones, called by the main loop.
+
+        Raises:
+        - CommunicationException: If the reload disconnected all devices of the session.
+        """
+        had_devices = len(self._connected_devices) > 0
+        for module_number in removed:
+            self._remove_module(module_number)
+        for module_number, future in futures.items():
+            try:
+                module = future.result()
+            except Exception as e:
+                kept = " previous version keeps running," if module_number in self._modules else ""
+                self._logger.error(f"Module {module_number}: Module could not be reloaded,{kept} {e}")
+                continue
+            self._replace_module(module_number, module, configs[module_number])
+        self._logger.info("Modules have been reloaded")
+        if had_devices and len(self._connected_devices) == 0:
+            # Car learns about disconnected devices from the connect sequence of the next session
+            self._logger.warning("All devices have been disconnected, restarting server")
+            raise CommunicationException()
+
+    def _load_module(self, module_number: int, module_config: ModuleConfig) -> ExternalServerApiClient:
+        module = ExternalServerApiClient(module_config, self._config.company_name, self._car_name)
+        try:
+            self._init_module(module_number, module)
+        except Exception:
+            if module.device_initialized():
+                module.destroy()
+            raise
+        return module
+
+    def _remove_module(self, module_number: int) -> None:
+        """Disconnects devices of the module and destroys it."""
+        for device in self._connected_devices:
+            if device.module == module_number:
+                self._disconnect_device(DisconnectTypes.announced, self._python_to_proto_device(device))
+        self._destroy_module(module_number)
+        del self._module_configs[module_number]
+        self._coalescing_modules.discard(module_number)
+        self._status_filter.set_module(module_number, None)
+        self._logger.info(f"Module {module_number} has been removed")
+
+    def _replace_module(self, module_number: int, module: ExternalServerApiClient, module_config: ModuleConfig) -> None:
+        """Starts initialized module in place of running module with the same number, if there is one.
+        Connected devices of the module are moved to the new instance."""
+        devices = [
+            self._python_to_proto_device(device)
+            for device in self._connected_devices
+            if device.module == module_number
+        ]
+        if module_number in self._modules:
+            for device in devices:
+                self._module_workers[module_number].submit(
+                    self._module_device_disconnected, DisconnectTypes.announced, device
+                )
+            # Held and not acknowledged commands were popped from the old instance
+            for key in [key for key, held in self._held_commands.items() if held[0] == module_number]:
+                del self._held_commands[key]
+            self._command_checker.disown_module_commands(module_number)
+            self._destroy_module(module_number)
+
+        self._modules[module_number] = module
+        self._module_configs[module_number] = module_config
+        if module_config.coalesce_commands:
+            self._coalescing_modules.add(module_number)
+        else:
+            self._coalescing_modules.discard(module_number)
+        self._status_filter.set_module(
+            module_number, StatusFilterSettings(module_config.deduplicate_statuses, module_config.min_status_interval)
+        )
+        if module_number not in self._command_handling:
+            self._init_module_metrics(module_number)
+        worker = ModuleWorker(module_number, module_config.queue_size, module_config.backpressure, self._car_name)
+        self._module_workers[module_number] = worker
+        worker.start()
+        for device in devices:
+            rc = worker.call(module.device_connected, device)
+            if rc != GeneralErrorCodes.OK:
                 self._logger.error(
-                    f"Module number {self._modules[int(module_number)].get_module_number()} returned from API does not match with module number {int(module_number)} in config"
+                    f"Device {device_repr(device)} could not be connected to reloaded module and is disconnected, "
+                    f"response from api: {rc}"
                 )
-                raise RuntimeError(f"Module number returned from API does not match with module number in config {self._modules[int(module_number)].get_module_number()}/{int(module_number)}")
-            self._modules_command_threads[int(module_number)] = CommandWaitingThread(
-                self._modules[int(module_number)]
-            )
+                # Old instance was already notified, the new one has not accepted the device
+                self._forget_device(device)
+
+        # Connection state of the command thread follows devices accepted by the new instance
+        command_thread = CommandWaitingThread(module, self._event_queue, self._command_event_priority(module_config))
+        command_thread.connection_established = self._connected_devices.module_device_count(module_number) > 0
+        self._modules_command_threads[module_number] = command_thread
+        command_thread.start()
+        self._logger.info(f"Module {module_number} has been loaded")
+
+    def _destroy_module(self, module_number: int) -> None:
+        """Stops command thread and worker of the module and destroys the module. Calls submitted to
+        the worker are made before the module is destroyed."""
+        command_thread = self._modules_command_threads.pop(module_number)
+        command_thread.stop()
+        command_thread.wait_for_join()
+        self._module_workers.pop(module_number).stop()
+        rc = self._modules.pop(module_number).destroy()
+        if rc != GeneralErrorCodes.OK:
+            self._logger.error(f"Module {module_number}: Error occurred in destroy function, rc: {rc}")
+
+    def _init_metrics(self) -> None:
+        registry = MetricsRegistry()
+        car = self._car_name
+        self._status_handling = registry.histogram(
+            "external_server_status_handling_seconds", "Duration of Status message handling", car=car
+        )
+        self._status_latency = registry.histogram(
+            "external_server_status_latency_seconds",
+            "Time between receiving Status message from broker and forwarding it to modules",
+            car=car,
+        )
+        self._command_response_handling = registry.histogram(
+            "external_server_command_response_handling_seconds",
+            "Duration of Command response message handling",
+            car=car,
+        )
+        self._command_handling = dict()
+        self._command_dispatch = dict()
+        self._coalesced_commands = dict()
+        for module_number in self._modules:
+            self._init_module_metrics(module_number)
+
+        registry.gauge(
+            "external_server_event_queue_depth",
+            "Number of events waiting in event queue",
+            self._event_queue.qsize,
+            car=car,
+        )
+        self._event_queue.register_metrics(car=car)
+        if self._owns_mqtt_client:
+            self._mqtt_client.register_metrics(car=car)
+
+    def _init_module_metrics(self, module_number: int) -> None:
+        registry = MetricsRegistry()
+        car = self._car_name
+        self._command_handling[module_number] = registry.histogram(
+            "external_server_command_handling_seconds",
+            "Duration of handling command available in module",
+            car=car,
+            module=str(module_number),
+        )
+        self._command_dispatch[module_number] = registry.histogram(
+            "external_server_command_dispatch_seconds",
+            "Time between popping command from module and publishing it",
+            car=car,
+            module=str(module_number),
+        )
+        self._coalesced_commands[module_number] = registry.counter(
+            "external_server_coalesced_commands_total",
+            "Number of held commands replaced by newer command for the same device",
+            car=car,
+            module=str(module_number),
+        )
+
+    def _create_transport(self) -> Transport:
+        codec = create_payload_codec(self._config, car=self._car_name)
+        if self._config.transport == TransportType.UNIX_SOCKET:
+            return UnixSocketClient(self._config.unix_socket_path, self._event_queue, codec=codec)
+        return MqttClient(
+            self._config.company_name,
+            self._car_name,
+            self._event_queue,
+            max_queued_messages=self._config.mqtt_max_queued_messages,
+            max_inflight_messages=self._config.mqtt_max_inflight_messages,
+            adaptive_queue=self._config.mqtt_adaptive_queue,
+            codec=codec,
+        )
 
     def set_tls(self, ca_certs: str, certfile: str, keyfile: str) -> None:
         "Set tls security to mqtt client"
@@ -76,23 +466,35 @@ class ExternalServer:
 
     def start(self) -> None:
         self._mqtt_client.init()
-        for module_number in self._modules:
-            self._modules_command_threads[module_number].start()
-
-        while True:
+        while self._running:
+            resumable = False
             try:
                 if not self._mqtt_client.is_connected:
                     self._mqtt_client.connect(self._config.mqtt_address, self._config.mqtt_port)
                     self._mqtt_client.start()
-                self._init_sequence()
+                self.wait_for_modules()
+                self._reload_modules()
+                if self._session_suspended_at is not None:
+                    self._resume_session()
+                else:
+                    self._init_sequence()
                 self._normal_communication()
+            except ModuleInitError:
+                raise
             except ConnectSequenceException:
                 self._logger.error("Connect sequence failed")
-            except ConnectionRefusedError:
-                self._logger.error(
-                    f"Unable to connect to MQTT broker on {self._config.mqtt_address}:{self._config.mqtt_port}, trying again"
-                )
+            except ConnectionRefusedError as e:
+                if self._config.transport == TransportType.UNIX_SOCKET:
+                    self._logger.error(f"Unable to listen on {self._config.unix_socket_path}: {e}, trying again")
+                else:
+                    self._logger.error(
+                        f"Unable to connect to MQTT broker on {self._config.mqtt_address}:{self._config.mqtt_port}, trying again"
+                    )
+                resumable = self._session_suspended_at is not None
                 time.sleep(self._config.sleep_duration_after_connection_refused)
+            except BrokerDisconnectedExc:
+                self._logger.error("Connection to MQTT broker has been lost")
+                resumable = self._config.session_resume_grace_period > 0
             except ClientDisconnectedExc:  # if 30 seconds any message has not been received
                 self._logger.error("Client timed out")
             except StatusTimeOutExc:
@@ -105,19 +507,103 @@ class ExternalServer:
                 self._logger.error(f"Unexpected error occurred: {e}")
                 time.sleep(self._config.sleep_duration_after_connection_refused)
             finally:
-                self._clear_context()
+                if resumable and self._running:
+                    self._suspend_session()
+                else:
+                    self._clear_context()
+
+    def request_stop(self) -> None:
+        """Makes the start function return once the current session ends. Modules are not
+        destroyed, stop must be called after start returns."""
+        self._running = False
+
+    def _suspend_session(self) -> None:
+        """Keeps session state for session_resume_grace_period, so that the session can continue
+        after reconnection to MQTT broker. Session is ended if the grace period has expired."""
+        now = time.monotonic()
+        if self._session_suspended_at is None:
+            self._logger.warning(
+                f"Session suspended, it can be resumed in {self._config.session_resume_grace_period} s"
+            )
+            self._session_suspended_at = now
+            self._mqtt_client.stop()
+            self._session_checker.stop()
+            self._cancel_status_ack_flush()
+            self._cancel_status_filter_flush()
+            self._command_checker.suspend_timers()
+            self._status_order_checker.suspend_timers()
+            self._event_queue.clear()
+        elif now - self._session_suspended_at > self._config.session_resume_grace_period:
+            self._logger.warning("Grace period of suspended session has expired")
+            self._clear_context()
+        else:
+            self._mqtt_client.stop()
+
+    def _resume_session(self) -> None:
+        """Continues suspended session if the car continues it, else starts new session.
+        Grace period is checked when the first message after reconnection is received."""
+        self._logger.info("Expecting a message of suspended session")
+        # Session stays suspended while the car is silent during the rest of the grace period
+        remaining_grace_period = (
+            self._session_suspended_at + self._config.session_resume_grace_period - time.monotonic()
+        )
+        received_msg = self._mqtt_client.get(timeout=max(self._config.mqtt_timeout, remaining_grace_period))
+        if received_msg == False:
+            # Session is suspended again, grace period is checked by _suspend_session
+            raise BrokerDisconnectedExc()
+        if received_msg == None:
+            self._logger.error("No message has been received after reconnection")
+            raise ConnectSequenceException()
+
+        expired = time.monotonic() - self._session_suspended_at > self._config.session_resume_grace_period
+        if received_msg.HasField("connect"):
+            self._logger.info("Car has started a new session")
+            self._clear_session()
+            self._init_sequence(received_msg)
+            return
+        if received_msg.HasField("status"):
+            session_id = received_msg.status.sessionId
+        elif received_msg.HasField("commandResponse"):
+            session_id = received_msg.commandResponse.sessionId
+        else:
+            session_id = None
+        if expired or session_id != self._session_id:
+            self._logger.warning("Suspended session can not be resumed, expecting a connect message")
+            self._clear_session()
+            self._init_sequence()
+            return
 
-    def _init_sequence(self) -> None:
+        self._logger.info("Session resumed")
+        self._session_suspended_at = None
+        self._command_checker.resume_timers()
+        self._status_order_checker.resume_timers()
+        self._session_checker.start()
+        self._handle_received_message(received_msg, self._mqtt_client.last_received_at)
+        self._flush_status_ack()
+        self._flush_filtered_statuses()
+        # Command available events were dropped while waiting for the message
+        for module_number in self._modules:
+            self._handle_command(module_number)
+
+    def _init_sequence(self, connect_msg: external_protocol.ExternalClient | None = None) -> None:
         self._logger.info("Starting the connect sequence")
-        self._init_seq_connect()
-        self._init_seq_status()
-        self._init_seq_command()
-        self._event_queue.clear()
+        self._init_seq_connect(connect_msg)
+        # Whole handshake following the connect message has to finish in one mqtt_timeout
+        deadline = time.monotonic() + self._config.mqtt_timeout
+        self._init_seq_status(deadline)
+        self._init_seq_command(deadline)
+        # Messages received after the last Command response are handled by normal communication
+        self._event_queue.clear(keep=(EventType.RECEIVED_MESSAGE, EventType.MQTT_BROKER_DISCONNECTED))
         self._logger.info("Connect sequence has finished succesfully")
+        # Command available events were dropped, commands popped from API since the connect sequence
+        # popped them would not be announced again
+        for module_number in self._modules:
+            self._handle_command(module_number)
 
-    def _init_seq_connect(self) -> None:
-        self._logger.info("Expecting a connect message")
-        received_msg = self._mqtt_client.get(timeout=self._config.mqtt_timeout)
+    def _init_seq_connect(self, received_msg: external_protocol.ExternalClient | None = None) -> None:
+        if received_msg is None:
+            self._logger.info("Expecting a connect message")
+            received_msg = self._mqtt_client.get(timeout=self._config.mqtt_timeout)
         if received_msg == None or received_msg == False:
             self._logger.error("Connect message has not been received")
             self._mqtt_client.stop()
@@ -126,7 +612,11 @@ class ExternalServer:
             self._logger.error("Received message is not a connect message")
             raise ConnectSequenceException()
         self._logger.info("Connect message has been received")
+        # Compression offered by a stale or foreign Connect is not used, only the accepted one
+        self._mqtt_client.accept_compression()
         self._session_id = received_msg.connect.sessionId
+        if self._command_journal is not None:
+            self._command_journal.start_session()
 
         devices = received_msg.connect.devices
         for device in devices:
@@ -149,17 +639,22 @@ class ExternalServer:
                     f"Failed to connect device with module number {device.module}, ignoring device"
                 )
 
+        # Connect sequence sends messages to all devices, including not connected ones
+        self._mqtt_client.set_device_count(len(self._connected_devices) + len(self._not_connected_devices))
         sent_msg = self._create_connect_response(external_protocol.ConnectResponse.Type.OK)
         self._logger.info("Sending connect response message")
         self._mqtt_client.publish(sent_msg)
 
-    def _init_seq_status(self) -> None:
-        device_count = range(len(self._connected_devices) + len(self._not_connected_devices))
-        self._logger.info(f"Expecting {len(device_count)} status messages")
+    def _init_seq_status(self, deadline: float) -> None:
+        expected_statuses = len(self._connected_devices) + len(self._not_connected_devices)
+        self._logger.info(f"Expecting {expected_statuses} status messages")
 
-        for iter in device_count:
-            self._logger.info(f"Waiting for status message {iter + 1}/{len(device_count)}")
-            status_msg = self._mqtt_client.get(timeout=self._config.mqtt_timeout)
+        # Statuses are accepted in any order and responded immediately, they are forwarded
+        # to modules once all of them are received
+        received_statuses: list[external_protocol.Status] = []
+        for iter in range(expected_statuses):
+            self._logger.info(f"Waiting for status message {iter + 1}/{expected_statuses}")
+            status_msg = self._mqtt_client.get(timeout=self._remaining_time(deadline))
             if status_msg == None or status_msg == False:
                 self._logger.error("Status message has not been received")
                 raise ConnectSequenceException()
@@ -168,7 +663,7 @@ class ExternalServer:
                 raise ConnectSequenceException()
 
             device = status_msg.status.deviceStatus.device
-            if not self._is_device_in_list(device, self._connected_devices):
+            if device not in self._connected_devices:
                 self._logger.warning(
                     f"Received status from not connected device, unique identificator:"
                     f" {device.module}/{device.deviceType}/{device.deviceRole}"
@@ -179,75 +674,78 @@ class ExternalServer:
                     f" expected: {external_protocol.Status.DeviceState.CONNECTING}"
                 )
                 raise ConnectSequenceException()
-
-            self._status_order_checker.check(status_msg.status)
-            self._status_order_checker.get_status()  # Checked status is not needed in Init sequence
             self._logger.info(
                 f"Received Status message, messageCounter: {status_msg.status.messageCounter}"
                 f" error: {status_msg.status.errorMessage}"
             )
+            received_statuses.append(status_msg.status)
+            self._publish_status_response(status_msg.status)
 
-            if device not in self._not_connected_devices:
-                if len(status_msg.status.errorMessage) > 0:
-                    rc = self._modules[device.module].forward_error_message(
-                        device, status_msg.status.errorMessage
-                    )
-                    if rc != GeneralErrorCodes.OK:
-                        self._logger.warning(
-                            f"Module {device.module}: Error occurred in forward_error_message function, rc: {rc}"
-                        )
+        received_statuses.sort(key=lambda status: status.messageCounter)
+        pending_statuses: dict[int, list[external_protocol.Status]] = dict()
+        for status in received_statuses:
+            self._status_order_checker.check(status)
+            self._status_order_checker.get_status()  # Checked status is not needed in Init sequence
+            device = status.deviceStatus.device
+            if device.module in self._modules and device not in self._not_connected_devices:
+                pending_statuses.setdefault(device.module, []).append(status)
+        self._run_for_modules(self._forward_init_statuses, pending_statuses)
 
-                rc = self._modules[device.module].forward_status(
-                    device, status_msg.status.deviceStatus.statusData
+    def _forward_init_statuses(self, module_num: int, statuses: list[external_protocol.Status]) -> None:
+        for status in statuses:
+            if len(status.errorMessage) > 0:
+                rc = self._modules[module_num].forward_error_message(
+                    status.deviceStatus.device, status.errorMessage
                 )
-                self._check_forward_status_rc(device.module, rc)
-
-            sent_msg = self._create_status_response(status_msg.status)
-            self._mqtt_client.publish(sent_msg)
+                if rc != GeneralErrorCodes.OK:
+                    self._logger.warning(
+                        f"Module {module_num}: Error occurred in forward_error_message function, rc: {rc}"
+                    )
+        rc = self._modules[module_num].forward_statuses(
+            [(status.deviceStatus.device, status.deviceStatus.statusData) for status in statuses]
+        )
+        self._check_forward_status_rc(module_num, rc)
 
-    def _init_seq_command(self) -> None:
+    def _init_seq_command(self, deadline: float) -> None:
         devices_with_no_command = self._connected_devices.copy()
         self._logger.info("Generating and sending commands to all devices")
-        
+        sent_commands = 0
+        # Devices, to which commands not acknowledged before crash were sent again
+        replayed_devices = DeviceRegistry()
+        if self._command_journal is not None:
+            for recovery_id, command in list(self._command_journal.recovered_commands().items()):
+                device = command.deviceCommand.device
+                if device not in self._connected_devices:
+                    self._logger.warning(
+                        f"Recovered command for not connected {device_repr(device)} is kept until the device connects"
+                    )
+                    continue
+                # Module instance, which returned the command, does not exist anymore, so it is not acknowledged
+                self._send_init_command(
+                    device, command.deviceCommand.commandData, returned_from_api=False, recovery_id=recovery_id
+                )
+                sent_commands += 1
+                devices_with_no_command.remove(device)
+                replayed_devices.add(device)
+
         for module in self._modules:
-            module_commands = []
-            rc = 0
-
-            while rc != None:
-                rc = self._modules_command_threads[module].pop_command()
-                if rc != None:
-                    command, for_device = rc
-                    module_commands.append([command, for_device])
-
-            for command, for_device in module_commands:
-                if not self._is_device_in_list(
-                    for_device, devices_with_no_command
-                ) and self._is_device_in_list(for_device, self._connected_devices):
+            module_commands = self._modules_command_threads[module].pop_commands()
+
+            for command, for_device, _ in module_commands:
+                # Command of the module follows commands replayed to the device
+                if devices_with_no_command.remove(for_device) or replayed_devices.remove(for_device):
+                    self._send_init_command(for_device, command, returned_from_api=True)
+                    sent_commands += 1
+                elif for_device in self._connected_devices:
                     self._logger.warning(
                         f"Command for {for_device.deviceName} device was returned from API more than once"
                     )
-                elif not self._is_device_in_list(for_device, devices_with_no_command):
+                else:
                     self._logger.warning(
                         f"Command returned from module {module}'s API is intended for not connected device, command won't be sent"
                     )
-                else:
-                    command_counter = self._command_checker.counter
-                    external_command = MessageCreator.create_external_command(
-                        self._session_id, command_counter, for_device, command
-                    )
-                    self._logger.info(f"Sending Command message, messageCounter: {command_counter}")
-                    self._mqtt_client.publish(external_command)
-                    self._command_checker.add_command(external_command.command, True)
-                    try:
-                        devices_with_no_command.remove(self._proto_to_python_device(for_device))
-                    except ValueError:
-                        self._logger.error(
-                            f"Received command for unexpected device in connect sequence:"
-                            f"{for_device.module}/{for_device.deviceType}/{for_device.deviceRole} named as {for_device.deviceName}"
-                        )
-                        raise ConnectSequenceException()
-
-        for device in devices_with_no_command + self._not_connected_devices:
+
+        for device in list(devices_with_no_command) + self._not_connected_devices:
             command_counter = self._command_checker.counter
             if type(device) is DeviceIdentificationPython:
                 device = self._python_to_proto_device(device)
@@ -260,13 +758,17 @@ class ExternalServer:
             self._logger.info(f"Sending Command message, messageCounter: {command_counter}")
             self._mqtt_client.publish(external_command)
             self._command_checker.add_command(external_command.command, True)
+            sent_commands += 1
 
-        device_count = range(len(self._connected_devices) + len(self._not_connected_devices))
-        self._logger.info(f"Expecting {len(device_count)} command response messages")
+        self._logger.info(f"Expecting {sent_commands} command response messages")
 
-        for iter in device_count:
-            self._logger.info(f"Waiting for command response message {iter + 1}/{len(device_count)}")
-            received_msg = self._mqtt_client.get(timeout=self._config.mqtt_timeout)
+        # Command responses are accepted in any order, commands are acknowledged to modules
+        # once all of them are received
+        acknowledged_commands = 0
+        pending_acks: dict[int, list[tuple[bytes, internal_protocol.Device]]] = dict()
+        while acknowledged_commands < sent_commands:
+            self._logger.info(f"Waiting for command response message {acknowledged_commands + 1}/{sent_commands}")
+            received_msg = self._mqtt_client.get(timeout=self._remaining_time(deadline))
             if received_msg == None or received_msg == False:
                 self._logger.error("Command response message has not been received")
                 raise ConnectSequenceException()
@@ -277,32 +779,61 @@ class ExternalServer:
             commands = self._command_checker.pop_commands(
                 received_msg.commandResponse.messageCounter
             )
+            acknowledged_commands += len(commands)
             for command, returned_from_api in commands:
-                if returned_from_api and self._proto_to_python_device(command.deviceCommand.device) in self._connected_devices:
-                    rc = self._modules[command.deviceCommand.device.module].command_ack(
-                        command.deviceCommand.commandData, command.deviceCommand.device
+                self._journal_ack(command)
+                if returned_from_api and command.deviceCommand.device in self._connected_devices:
+                    pending_acks.setdefault(command.deviceCommand.device.module, []).append(
+                        (command.deviceCommand.commandData, command.deviceCommand.device)
                     )
-                    self._check_command_ack_rc(command.deviceCommand.device.module, rc)
+        self._run_for_modules(self._ack_module_commands, pending_acks)
+
+    def _send_init_command(
+        self,
+        device: internal_protocol.Device,
+        command: bytes,
+        returned_from_api: bool,
+        recovery_id: int | None = None,
+    ) -> None:
+        """Sends command in the connect sequence, recovery_id is given for command recovered from journal."""
+        command_counter = self._command_checker.counter
+        external_command = MessageCreator.create_external_command(self._session_id, command_counter, device, command)
+        self._logger.info(f"Sending Command message, messageCounter: {command_counter}")
+        self._mqtt_client.publish(external_command, self._command_priority(device.module, device))
+        self._command_checker.add_command(external_command.command, returned_from_api)
+        if recovery_id is None:
+            self._journal_command(external_command.command)
+        else:
+            # Recovered command stays in the journal until this Command is acknowledged
+            self._command_journal.replayed(recovery_id, command_counter)
+
+    @staticmethod
+    def _remaining_time(deadline: float) -> float:
+        return max(0.0, deadline - time.monotonic())
+
+    def _run_for_modules(self, function: Callable[[int, list], None], messages: dict[int, list]) -> None:
+        """Calls function with messages of every module by the module worker and waits for all of them,
+        modules are handled in parallel."""
+        futures = [
+            self._module_workers[module_num].submit(function, module_num, module_messages)
+            for module_num, module_messages in messages.items()
+        ]
+        for future in futures:
+            future.result()
 
     def _normal_communication(self) -> None:
         self._session_checker.start()
+        # Reload events could have been dropped with other events during the connect sequence
+        self._reload_modules()
         while True:
             event = self._event_queue.get()
             if event.event == EventType.RECEIVED_MESSAGE:
-                received_msg = self._mqtt_client.get(timeout=None)
-                if received_msg == False:
-                    raise CommunicationException()
-                elif received_msg is not None:
-                    if received_msg.HasField("connect"):
-                        self._handle_connect(received_msg.connect.sessionId)
-
-                    elif received_msg.HasField("status"):
-                        self._handle_status(received_msg.status)
-
-                    elif received_msg.HasField("commandResponse"):
-                        self._handle_command_response(received_msg.commandResponse)
+                # Message is carried by the event, MQTT client does not queue it again,
+                # compression negotiated by a Connect received in normal communication is not used
+                received_msg, received_at, _ = event.data
+                self._handle_received_message(received_msg, received_at)
             elif event.event == EventType.MQTT_BROKER_DISCONNECTED:
-                raise CommunicationException()
+                raise BrokerDisconnectedExc()
             elif event.event == EventType.TIMEOUT_OCCURRED:
                 if event.data == TimeoutType.SESSION_TIMEOUT:
                     raise ClientDisconnectedExc()
@@ -314,14 +845,37 @@ class ExternalServer:
                     self._logger.error(
                         "Internal error: Received Event TimeoutOccurred without TimeoutType"
                     )
+            elif event.event == EventType.STATUS_ACK_FLUSH:
+                self._flush_status_ack()
+            elif event.event == EventType.STATUS_FILTER_FLUSH:
+                self._flush_filtered_statuses()
+            elif event.event == EventType.MODULES_RELOAD or event.event == EventType.MODULES_RELOAD_READY:
+                self._reload_modules()
             elif event.event == EventType.COMMAND_AVAILABLE:
-                if isinstance(event.data, int):
+                if event.data in self._modules_command_threads:
+                    start = time.perf_counter()
                     self._handle_command(event.data)
-                else:
+                    self._command_handling[event.data].observe(time.perf_counter() - start)
+                elif not isinstance(event.data, int):
                     self._logger.error(
                         "Internal error: Received Event CommandAvailable without module number"
                     )
 
+    def _handle_received_message(self, received_msg: external_protocol.ExternalClient, received_at: float) -> None:
+        if received_msg.HasField("connect"):
+            self._handle_connect(received_msg.connect.sessionId)
+
+        elif received_msg.HasField("status"):
+            start = time.perf_counter()
+            self._handle_status(received_msg.status)
+            self._status_handling.observe(time.perf_counter() - start)
+            self._status_latency.observe(time.monotonic() - received_at)
+
+        elif received_msg.HasField("commandResponse"):
+            start = time.perf_counter()
+            self._handle_command_response(received_msg.commandResponse)
+            self._command_response_handling.observe(time.perf_counter() - start)
+
     def _handle_connect(self, received_msg_session_id: str) -> None:
         self._logger.warning("Received Connect message when already connected")
         if self._session_id == received_msg_session_id:
@@ -333,13 +887,19 @@ class ExternalServer:
         self._mqtt_client.publish(sent_msg)
 
     def _handle_status(self, received_status: external_protocol.Status) -> None:
+        # Per-message logs are formatted lazily, they may be sampled or written by log listener thread
         self._logger.info(
-            f"Received Status message, messageCounter: {received_status.messageCounter}"
-            f" error: {received_status.errorMessage}"
+            "Received Status message, messageCounter: %d error: %s",
+            received_status.messageCounter,
+            received_status.errorMessage,
+            extra=STATUS_LOG,
         )
         self._reset_session_checker_if_session_id_is_ok(received_status.sessionId)
         self._status_order_checker.check(received_status)
 
+        # Statuses are forwarded in batches per module, batch of a module is forwarded before
+        # the module is notified about connection or disconnection of its device
+        pending_statuses: dict[int, list[tuple[internal_protocol.Device, bytes]]] = dict()
         while (status := self._status_order_checker.get_status()) is not None:
             device = status.deviceStatus.device
             
@@ -358,30 +918,32 @@ class ExternalServer:
                 continue
 
             if status.deviceState == external_protocol.Status.DeviceState.RUNNING:
-                if not self._is_device_in_list(device, self._connected_devices):
+                if device not in self._connected_devices:
                     self._logger.error(f"Device {device_repr(device)} is not connected")
                     continue
-                rc = self._modules[device.module].forward_status(
-                    device, status.deviceStatus.statusData
-                )
-                self._check_forward_status_rc(device.module, rc)
+                if self._status_filter.forward(device, status.deviceStatus.statusData, time.monotonic()):
+                    pending_statuses.setdefault(device.module, []).append(
+                        (device, status.deviceStatus.statusData)
+                    )
+                else:
+                    self._schedule_status_filter_flush()
             elif status.deviceState == external_protocol.Status.DeviceState.CONNECTING:
-                if self._is_device_in_list(device, self._connected_devices):
+                if device in self._connected_devices:
                     self._logger.error(f"Device {device_repr(device)} is already connected")
                     continue
+                self._forward_pending_statuses(pending_statuses, device.module)
                 self._connect_device(device)
-                rc = self._modules[device.module].forward_status(
-                    device, status.deviceStatus.statusData
+                pending_statuses.setdefault(device.module, []).append(
+                    (device, status.deviceStatus.statusData)
                 )
-                self._check_forward_status_rc(device.module, rc)
             elif status.deviceState == external_protocol.Status.DeviceState.DISCONNECT:
-                if not self._is_device_in_list(device, self._connected_devices):
+                if device not in self._connected_devices:
                     self._logger.error(f"Device {device_repr(device)} is not connected")
                     continue
-                rc = self._modules[device.module].forward_status(
-                    device, status.deviceStatus.statusData
+                pending_statuses.setdefault(device.module, []).append(
+                    (device, status.deviceStatus.statusData)
                 )
-                self._check_forward_status_rc(device.module, rc)
+                self._forward_pending_statuses(pending_statuses, device.module)
                 self._disconnect_device(DisconnectTypes.announced, device)
                 self._logger.warning(
                     f"Status announces that device {device.deviceName} was disconnected"
@@ -392,42 +954,170 @@ class ExternalServer:
                     f"Status for device {device_repr(device)} contains error message"
                 )
 
-            status_response = self._create_status_response(status)
-            self._mqtt_client.publish(status_response)
+            self._acknowledge_status(status)
             if len(self._connected_devices) == 0:
+                    self._flush_status_ack()
+                    self._forward_pending_statuses(pending_statuses)
                     self._logger.warning("All devices have been disconnected, restarting server")
                     raise CommunicationException()
 
+        self._forward_pending_statuses(pending_statuses)
+
+    def _forward_pending_statuses(
+        self,
+        pending_statuses: dict[int, list[tuple[internal_protocol.Device, bytes]]],
+        module_num: int | None = None,
+    ) -> None:
+        """Forwards pending statuses of given module or of all modules if module_num is None."""
+        module_numbers = list(pending_statuses) if module_num is None else [module_num]
+        for module_number in module_numbers:
+            statuses = pending_statuses.pop(module_number, None)
+            if statuses and self._module_workers[module_number].submit(
+                self._forward_module_statuses, module_number, statuses, droppable=True
+            ) is None:
+                self._disconnect_stalled_module(module_number)
+
+    def _forward_module_statuses(
+        self, module_num: int, statuses: list[tuple[internal_protocol.Device, bytes]]
+    ) -> None:
+        rc = self._modules[module_num].forward_statuses(statuses)
+        self._check_forward_status_rc(module_num, rc)
+
+    def _disconnect_stalled_module(self, module_num: int) -> None:
+        """Disconnects all devices of module, which does not keep up with forwarded statuses.
+
+        Raises:
+        - CommunicationException: If no device remains connected.
+        """
+        dropped = self._module_workers[module_num].drop_statuses()
+        self._logger.error(
+            f"Module {module_num} does not keep up with statuses, {dropped + 1} status batches dropped, "
+            "disconnecting its devices"
+        )
+        for device in list(self._connected_devices):
+            if device.module == module_num:
+                self._disconnect_device(DisconnectTypes.error, self._python_to_proto_device(device))
+        if len(self._connected_devices) == 0:
+            self._logger.warning("All devices have been disconnected, restarting server")
+            raise CommunicationException()
+
+    def _flush_filtered_statuses(self) -> None:
+        """Forwards statuses held by status filter, which interval has elapsed."""
+        self._cancel_status_filter_flush()
+        pending_statuses: dict[int, list[tuple[internal_protocol.Device, bytes]]] = dict()
+        for device, data in self._status_filter.take_due(time.monotonic()):
+            if device in self._connected_devices:
+                pending_statuses.setdefault(device.module, []).append((device, data))
+        self._forward_pending_statuses(pending_statuses)
+        self._schedule_status_filter_flush()
+
+    def _schedule_status_filter_flush(self) -> None:
+        due = self._status_filter.next_due()
+        if due is None or (self._status_filter_flush is not None and self._status_filter_flush.when <= due):
+            return
+        self._cancel_status_filter_flush()
+        self._status_filter_flush = DeadlineScheduler().schedule(
+            max(due - time.monotonic(), 0),
+            lambda: self._event_queue.add_event(event_type=EventType.STATUS_FILTER_FLUSH),
+        )
+
+    def _cancel_status_filter_flush(self) -> None:
+        if self._status_filter_flush is not None:
+            self._status_filter_flush.cancel()
+            self._status_filter_flush = None
+
     def _handle_command_response(self, command_response: external_protocol.CommandResponse) -> None:
-        self._logger.info("Received command response")
+        self._logger.info(
+            "Received Command response message, messageCounter: %d",
+            command_response.messageCounter,
+            extra=COMMAND_RESPONSE_LOG,
+        )
         self._reset_session_checker_if_session_id_is_ok(command_response.sessionId)
 
         device_not_connected = (
             command_response.type == external_protocol.CommandResponse.Type.DEVICE_NOT_CONNECTED
         )
         commands = self._command_checker.pop_commands(command_response.messageCounter)
-        for command, _ in commands:
-            rc = self._modules[command.deviceCommand.device.module].command_ack(
-                command.deviceCommand.commandData, command.deviceCommand.device
-            )
-            self._check_command_ack_rc(command.deviceCommand.device.module, rc)
+        pending_acks: dict[int, list[tuple[bytes, internal_protocol.Device]]] = dict()
+        for command, returned_from_api in commands:
+            self._journal_ack(command)
+            device = command.deviceCommand.device
+            if returned_from_api:
+                pending_acks.setdefault(device.module, []).append((command.deviceCommand.commandData, device))
             if device_not_connected and command.messageCounter == command_response.messageCounter:
+                self._ack_pending_commands(pending_acks, device.module)
                 self._disconnect_device(DisconnectTypes.announced, command.deviceCommand.device)
                 self._logger.warning(
                     f"Command response announces that device {command.deviceCommand.device.deviceName} was disconnected"
                 )
+        self._ack_pending_commands(pending_acks)
+        for command, _ in commands:
+            self._send_held_command(command.deviceCommand.device)
+
+    def _ack_pending_commands(
+        self,
+        pending_acks: dict[int, list[tuple[bytes, internal_protocol.Device]]],
+        module_num: int | None = None,
+    ) -> None:
+        """Acknowledges pending commands of given module or of all modules if module_num is None."""
+        module_numbers = list(pending_acks) if module_num is None else [module_num]
+        for module_number in module_numbers:
+            commands = pending_acks.pop(module_number, None)
+            # Commands of removed module are not acknowledged
+            if commands and module_number in self._module_workers:
+                self._module_workers[module_number].submit(self._ack_module_commands, module_number, commands)
+
+    def _ack_module_commands(self, module_num: int, commands: list[tuple[bytes, internal_protocol.Device]]) -> None:
+        rc = self._modules[module_num].command_acks(commands)
+        self._check_command_ack_rc(module_num, rc)
 
     def _handle_command(self, module_num: int) -> None:
-        command_counter = self._command_checker.counter
-        command, for_device = self._modules_command_threads[module_num].pop_command()
+        """Sends all commands available in the module, so no command waits for the next event."""
+        for command, for_device, available_at in self._modules_command_threads[module_num].pop_commands():
+            if (
+                module_num in self._coalescing_modules
+                and for_device in self._connected_devices
+                and self._command_checker.device_command_count(for_device) > 0
+            ):
+                self._hold_command(module_num, command, for_device, available_at)
+            else:
+                self._send_command(module_num, command, for_device, available_at)
+
+    def _hold_command(
+        self, module_num: int, command: bytes, for_device: internal_protocol.Device, available_at: float
+    ) -> None:
+        """Holds command until previous command for the device is acknowledged. Held command
+        replaced by this one is acknowledged to the module without being sent."""
+        key = DeviceRegistry.key(for_device)
+        superseded = self._held_commands.get(key)
+        self._held_commands[key] = (module_num, command, for_device, available_at)
+        if superseded is not None:
+            _, superseded_command, superseded_device, _ = superseded
+            self._logger.info(f"Held command for {device_repr(for_device)} was replaced by newer command")
+            self._coalesced_commands[module_num].inc()
+            self._module_workers[module_num].submit(
+                self._ack_module_commands, module_num, [(superseded_command, superseded_device)]
+            )
+
+    def _send_held_command(self, device: internal_protocol.Device) -> None:
+        """Sends command held for the device, if all previous commands for it were acknowledged."""
+        key = DeviceRegistry.key(device)
+        if key not in self._held_commands or self._command_checker.device_command_count(device) > 0:
+            return
+        module_num, command, for_device, available_at = self._held_commands.pop(key)
+        self._send_command(module_num, command, for_device, available_at)
 
-        if not self._is_device_in_list(for_device, self._connected_devices):
+    def _send_command(
+        self, module_num: int, command: bytes, for_device: internal_protocol.Device, available_at: float
+    ) -> None:
+        command_counter = self._command_checker.counter
+        if for_device not in self._connected_devices:
             self._logger.warning(
                 f"Command returned from module {module_num}'s API is intended for not connected device, command won't be sent"
             )
             return
 
-        self._logger.info(f"Sending Command message, messageCounter: {command_counter}")
+        self._logger.info("Sending Command message, messageCounter: %d", command_counter, extra=COMMAND_LOG)
         external_command = MessageCreator.create_external_command(
             self._session_id, command_counter, for_device, command
         )
@@ -445,12 +1135,24 @@ class ExternalServer:
             )
             if self._config.send_invalid_command:
                 self._logger.warning("Sending Command message with possibly invalid device")
-                self._mqtt_client.publish(external_command)
+                self._mqtt_client.publish(external_command, self._command_priority(module_num, for_device))
+                self._journal_command(external_command.command)
+                self._command_dispatch[module_num].observe(time.monotonic() - available_at)
             else:
                 self._logger.warning("The Command will not be sent")
                 self._command_checker.pop_commands(external_command.command.messageCounter)
         else:
-            self._mqtt_client.publish(external_command)
+            self._mqtt_client.publish(external_command, self._command_priority(module_num, for_device))
+            self._journal_command(external_command.command)
+            self._command_dispatch[module_num].observe(time.monotonic() - available_at)
+
+    def _journal_command(self, command: external_protocol.Command) -> None:
+        if self._command_journal is not None:
+            self._command_journal.append(command)
+
+    def _journal_ack(self, command: external_protocol.Command) -> None:
+        if self._command_journal is not None:
+            self._command_journal.ack(command.messageCounter)
 
     def _create_connect_response(
         self, connect_response_type: int
@@ -460,27 +1162,56 @@ class ExternalServer:
         )
         return MessageCreator.create_connect_response(self._session_id, connect_response_type)
 
-    def _create_status_response(
-        self, status: external_protocol.Status
-    ) -> external_protocol.ExternalServer:
+    def _acknowledge_status(self, status: external_protocol.Status) -> None:
+        """Responds the status, or with cumulative status acknowledgement keeps it as the newest
+        status to be responded when the flush interval elapses."""
+        if self._config.cumulative_status_ack_interval == 0:
+            self._publish_status_response(status)
+            return
+        # Checked statuses come in order, so the status acknowledges all previous ones
+        self._pending_status_ack = status
+        if self._status_ack_flush is None:
+            self._status_ack_flush = DeadlineScheduler().schedule(
+                self._config.cumulative_status_ack_interval,
+                lambda: self._event_queue.add_event(event_type=EventType.STATUS_ACK_FLUSH),
+            )
+
+    def _flush_status_ack(self) -> None:
+        """Sends cumulative Status response for the newest checked status, if there is any."""
+        self._cancel_status_ack_flush()
+        if self._pending_status_ack is not None:
+            self._publish_status_response(self._pending_status_ack)
+            self._pending_status_ack = None
+
+    def _cancel_status_ack_flush(self) -> None:
+        if self._status_ack_flush is not None:
+            self._status_ack_flush.cancel()
+            self._status_ack_flush = None
+
+    def _publish_status_response(self, status: external_protocol.Status) -> None:
         module = status.deviceStatus.device.module
         if module not in self._modules:
             self._logger.warning(f"Module {module} is not supported")
         self._logger.info(
-            f"Sending Status response message, messageCounter: {status.messageCounter}"
+            "Sending Status response message, messageCounter: %d", status.messageCounter, extra=STATUS_RESPONSE_LOG
+        )
+        # Status responses are the most frequent messages, they are serialized without creating messages
+        self._mqtt_client.publish_serialized(
+            self._status_response_serializer.serialize(status.sessionId, status.messageCounter)
         )
-        return MessageCreator.create_status_response(status.sessionId, status.messageCounter)
 
     def _connect_device(self, device: internal_protocol.Device) -> int:
         # External server needs to ignore priority
         device.priority = 0
-        rc = self._modules[device.module].device_connected(device)
+        # Waits for the module, connection of the device depends on the result
+        rc = self._module_workers[device.module].call(self._modules[device.module].device_connected, device)
         self._adjust_connection_state_of_module_thread(device.module, True)
         if rc == GeneralErrorCodes.OK:
             self._logger.info(
                 f"Connected device unique identificator: {device.module}/{device.deviceType}/{device.deviceRole} named as {device.deviceName}"
             )
-            self._connected_devices.append(self._proto_to_python_device(device))
+            self._connected_devices.add(device)
+            self._mqtt_client.set_device_count(len(self._connected_devices))
         else:
             self._logger.error(
                 f"Device with unique identificator: {device.module}/{device.deviceType}/{device.deviceRole} "
@@ -493,28 +1224,31 @@ class ExternalServer:
     ) -> None:
         # External server needs to ignore priority
         device.priority = 0
-        try:
-            self._connected_devices.remove(self._proto_to_python_device(device))
-        except ValueError:
+        if not self._forget_device(device):
             return
+        self._module_workers[device.module].submit(self._module_device_disconnected, disconnect_types, device)
+        self._adjust_connection_state_of_module_thread(device.module, False)
 
+    def _forget_device(self, device: internal_protocol.Device) -> bool:
+        """Removes connected device and its state kept by the server, the module is not notified.
+        Returns False if the device is not connected."""
+        if not self._connected_devices.remove(device):
+            return False
+        self._held_commands.pop(DeviceRegistry.key(device), None)
+        self._status_filter.remove(device)
+        self._mqtt_client.set_device_count(len(self._connected_devices))
+        return True
+
+    def _module_device_disconnected(self, disconnect_types: DisconnectTypes, device: internal_protocol.Device) -> None:
         rc = self._modules[device.module].device_disconnected(disconnect_types, device)
         self._check_device_disconnected_rc(device.module, rc)
-        self._adjust_connection_state_of_module_thread(device.module, False)
-
-    def _is_device_in_list(self, device: internal_protocol.Device, list) -> bool:
-        return self._proto_to_python_device(device) in list
 
     def _adjust_connection_state_of_module_thread(self, device_module: int, connected: bool):
-        for device in self._connected_devices:
-            if device_module == device.module:
-                # There is connected device with same module, no need to adjust the module thread
-                return
+        if self._connected_devices.module_device_count(device_module) > 0:
+            # There is connected device with same module, no need to adjust the module thread
+            return
 
-        if connected:
-            self._modules_command_threads[device_module].connection_established = True
-        else:
-            self._modules_command_threads[device_module].connection_established = False
+        self._modules_command_threads[device_module].connection_established = connected
 
     def _check_forward_status_rc(self, module_num: int, rc: int) -> None:
         if rc != GeneralErrorCodes.OK:
@@ -538,11 +1272,6 @@ class ExternalServer:
         if self._session_id == msg_session_id:
             self._session_checker.reset()
 
-    def _proto_to_python_device(self, device: internal_protocol.Device) -> DeviceIdentificationPython:
-        return DeviceIdentificationPython(
-            device.module, device.deviceType, device.deviceRole, device.deviceName, device.priority
-        )
-    
     def _python_to_proto_device(self, device: DeviceIdentificationPython) -> internal_protocol.Device:
         device_proto = internal_protocol.Device()
         device_proto.module = device.module
@@ -554,27 +1283,58 @@ class ExternalServer:
 
     def _clear_context(self) -> None:
         self._mqtt_client.stop()
+        self._clear_session()
+
+    def _clear_session(self) -> None:
+        """Ends the session, all devices are disconnected. Connection to MQTT broker is not affected."""
+        self._session_suspended_at = None
         self._command_checker.reset()
         self._session_checker.stop()
+        self._cancel_status_ack_flush()
+        self._pending_status_ack = None
+        self._cancel_status_filter_flush()
+        self._status_filter.clear()
         self._status_order_checker.reset()
+        if self._command_journal is not None:
+            self._command_journal.end_session()
 
         for device in self._connected_devices:
-            rc = self._modules[device.module].device_disconnected(DisconnectTypes.timeout, self._python_to_proto_device(device))
-            self._check_device_disconnected_rc(device.module, rc)
+            self._module_workers[device.module].submit(
+                self._module_device_disconnected, DisconnectTypes.timeout, self._python_to_proto_device(device)
+            )
+
+        for module_num, module in self._modules.items():
+            self._module_workers[module_num].submit(module.clear_device_identifications)
+        # Modules finish the session before the next one starts
+        for worker in self._module_workers.values():
+            worker.drain()
 
         for command_thread in self._modules_command_threads.values():
             command_thread.connection_established = False
 
         self._connected_devices.clear()
         self._not_connected_devices.clear()
+        self._held_commands.clear()
+        self._mqtt_client.set_device_count(0)
         self._event_queue.clear()
 
     def _clear_modules(self) -> None:
+        wait(self._module_init.values())
+        if self._module_reload is not None:
+            # Modules loaded by unfinished reload were never started
+            for future in self._module_reload[2].values():
+                if future.exception() is None:
+                    future.result().destroy()
+            self._module_reload = None
         for module_number in self._modules_command_threads:
             self._modules_command_threads[module_number].stop()
 
         for module_num in self._modules:
-            self._modules_command_threads[module_num].wait_for_join()
+            if module_num in self._modules_command_threads:
+                self._modules_command_threads[module_num].wait_for_join()
+            self._module_workers[module_num].stop()
+            if not self._modules[module_num].device_initialized():
+                continue
             rc = self._modules[module_num].destroy()
             if rc != GeneralErrorCodes.OK:
                 self._logger.error(
@@ -582,7 +1342,15 @@ class ExternalServer:
                 )
 
         self._modules.clear()
+        self._modules_command_threads.clear()
+        self._modules_ready = False
 
     def stop(self) -> None:
         self._clear_modules()
+        if self._command_journal is not None:
+            self._command_journal.close()
+        MetricsRegistry().remove_gauge("external_server_event_queue_depth", car=self._car_name)
+        if self._owns_mqtt_client:
+            MetricsRegistry().remove_readiness_check(self._car_name)
+            self._mqtt_client.remove_metrics()
         self._logger.info("Server stopped by keyboard interrupt")
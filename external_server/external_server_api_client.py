@@ -1,6 +1,10 @@
+import contextlib
 import ctypes as ct
+import logging
 import threading
+import time
 import sys
+from typing import Callable
 
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
@@ -13,8 +17,66 @@ from external_server.structures import (
     Buffer,
     DeviceIdentification,
     DisconnectTypes,
+    GeneralErrorCodes,
+    ThreadSafety,
 )
 from external_server.config import ModuleConfig
+from external_server.device_registry import DeviceRegistry
+from external_server.metrics import Histogram, MetricsRegistry
+
+try:
+    # Optional native extension, built from external_server/_fastpath.c
+    from external_server import _fastpath
+except ImportError:
+    _fastpath = None
+
+# Libraries are shared by all API clients using the same shared library (one client per car
+# in multi-car mode), every client still creates its own context by calling init
+_loaded_libraries: dict[str, ct.CDLL] = dict()
+_loaded_libraries_lock = threading.Lock()
+
+# void (*)(void *user_data), called by the library when a command becomes available
+CommandCallback = ct.CFUNCTYPE(None, ct.c_void_p)
+
+
+class _BufferStorage:
+    """Memory owned by Python, which is lent to the library as Buffer."""
+
+    __slots__ = "_memory"
+
+    def __init__(self, size: int) -> None:
+        self._memory = ct.create_string_buffer(size)
+
+    def buffer(self) -> Buffer:
+        """Returns Buffer pointing to the storage, size is set to the storage capacity."""
+        return Buffer(data=ct.cast(self._memory, ct.c_char_p), size=len(self._memory))
+
+    def reserve(self, size: int) -> bool:
+        """Enlarges the storage to at least size bytes, returns True if it was enlarged."""
+        if size <= len(self._memory):
+            return False
+        self._memory = ct.create_string_buffer(size)
+        return True
+
+
+class _LockPair:
+    """Holds lock of status path and lock of command path, which may be the same lock."""
+
+    __slots__ = ("_status_lock", "_command_lock")
+
+    def __init__(self, status_lock: threading.Lock, command_lock: threading.Lock) -> None:
+        self._status_lock = status_lock
+        self._command_lock = command_lock
+
+    def __enter__(self) -> None:
+        self._status_lock.acquire()
+        if self._command_lock is not self._status_lock:
+            self._command_lock.acquire()
+
+    def __exit__(self, *_exc_info) -> None:
+        if self._command_lock is not self._status_lock:
+            self._command_lock.release()
+        self._status_lock.release()
 
 
 class ExternalServerApiClient:
@@ -27,12 +89,31 @@ class ExternalServerApiClient:
     which represents every'API function, is called with Protobuf messages. Then
     these structures are properly converted and function from API is called. This
     class also implements lock on every API function (except wait_for_command)
-    according to Fleet protocol.
+    according to Fleet protocol. Module declaring its thread safety by get_thread_safety
+    API function or thread_safety in module config is locked less: SPLIT has separate locks
+    of command path (pop_command, register_command_callback) and status path (all other
+    functions), CONCURRENT locks only init and destroy.
     Class also implements some helper functions like deallocate, get_module_number
     and is_device_type_supported.
+    Optional batch functions forward_status_batch and command_ack_batch are used if the
+    library exports them, otherwise batches are passed to API one message at a time.
+    Duration of every API function call is recorded to histogram labelled by car, module
+    and function. If the library exports register_command_callback, the library notifies
+    about available commands by calling registered callback instead of being polled by
+    wait_for_command. If the native extension _fastpath is built, statuses are passed to
+    forward_status and forward_status_batch by the extension with the GIL released, without
+    creating ctypes structures.
 
     """
 
+    # Initial sizes of buffers passed to pop_command_into, enlarged when the library needs more
+    _POP_COMMAND_INITIAL_SIZE = 4096
+    _POP_DEVICE_NAME_INITIAL_SIZE = 256
+
+    _COMMAND_PATH_FUNCTIONS = ("pop_command", "pop_command_into", "register_command_callback")
+    _NATIVE_FUNCTIONS = ("forward_status", "forward_status_batch")
+    _LIFECYCLE_FUNCTIONS = ("init", "destroy")
+
     def __init__(self, module_config: ModuleConfig, company_name: str, car_name: str) -> None:
         """Initializes API Wrapper for Module
 
@@ -47,12 +128,35 @@ class ExternalServerApiClient:
         car_name : str
             car name from Json config, which will be forwarded as second key-value to API
         """
+        self._logger = logging.getLogger(self.__class__.__name__)
         self._lib_path = module_config.lib_path.absolute().as_posix()
         self._config = {"company_name": company_name, "car_name": car_name}
         self._config.update(module_config.config)
         self._library = None
         self._context = None
-        self._lock = threading.Lock()
+        self._thread_safety = ThreadSafety.SERIALIZED
+        self._configured_thread_safety = module_config.thread_safety
+        self._status_lock = threading.Lock()
+        # Same lock as status lock unless the module allows concurrent status and command paths
+        self._command_lock = self._status_lock
+        self._function_locks: dict[str, contextlib.AbstractContextManager] = dict()
+        self._default_lock: contextlib.AbstractContextManager = self._status_lock
+        self._forward_status_batch_supported = False
+        self._command_ack_batch_supported = False
+        self._pop_command_into_supported = False
+        self._command_callback_supported = False
+        # Addresses of library functions called by the native extension
+        self._native_functions: dict[str, int] = dict()
+        # Reference to registered callback, the callback must not be freed while the library can call it
+        self._command_callback: CommandCallback | None = None
+        self._pop_command_storage = _BufferStorage(self._POP_COMMAND_INITIAL_SIZE)
+        self._pop_device_role_storage = _BufferStorage(self._POP_DEVICE_NAME_INITIAL_SIZE)
+        self._pop_device_name_storage = _BufferStorage(self._POP_DEVICE_NAME_INITIAL_SIZE)
+        # Identifications of connected devices, so that they are not created for every API call,
+        # keyed as in DeviceRegistry, so that a device reconnected with another name replaces its entry
+        self._device_identifications: dict[tuple[int, int, str], DeviceIdentification] = dict()
+        self._module_number = ""
+        self._call_histograms: dict[str, Histogram] = dict()
 
     def init(self) -> None:
         """
@@ -61,11 +165,63 @@ class ExternalServerApiClient:
         if not check_file_exists(self._lib_path):
             raise FileNotFoundError(self._lib_path)
 
-        self._library = ct.cdll.LoadLibrary(self._lib_path)
-        self._type_all_function()
-
+        with _loaded_libraries_lock:
+            if self._lib_path in _loaded_libraries:
+                self._library = _loaded_libraries[self._lib_path]
+            else:
+                self._library = ct.cdll.LoadLibrary(self._lib_path)
+                self._type_all_function()
+                _loaded_libraries[self._lib_path] = self._library
+
+        self._forward_status_batch_supported = hasattr(self._library, "forward_status_batch")
+        self._command_ack_batch_supported = hasattr(self._library, "command_ack_batch")
+        self._pop_command_into_supported = hasattr(self._library, "pop_command_into")
+        self._command_callback_supported = hasattr(self._library, "register_command_callback")
+        self._module_number = str(self._library.get_module_number())
+        if _fastpath is not None:
+            self._native_functions = {
+                function: ct.cast(getattr(self._library, function), ct.c_void_p).value
+                for function in self._NATIVE_FUNCTIONS
+                if hasattr(self._library, function)
+            }
+            self._logger.info(f"Module {self._module_number}: Statuses are forwarded by native extension")
+        self._set_thread_safety()
         self._set_context()
 
+    def _set_thread_safety(self) -> None:
+        """
+        Sets locks of API functions by thread safety from module config, or declared by the library
+        if it is not configured. Libraries declaring nothing are SERIALIZED.
+        """
+        thread_safety = self._configured_thread_safety
+        if thread_safety is None and hasattr(self._library, "get_thread_safety"):
+            level = self._library.get_thread_safety()
+            levels = list(ThreadSafety)
+            if 0 <= level < len(levels):
+                thread_safety = levels[level]
+            else:
+                self._logger.warning(
+                    f"Module {self._module_number}: Unknown thread safety {level} returned from API, calls are serialized"
+                )
+        self._thread_safety = thread_safety if thread_safety is not None else ThreadSafety.SERIALIZED
+
+        self._status_lock = threading.Lock()
+        self._command_lock = self._status_lock if self._thread_safety == ThreadSafety.SERIALIZED else threading.Lock()
+        self._function_locks = {
+            function: _LockPair(self._status_lock, self._command_lock) for function in self._LIFECYCLE_FUNCTIONS
+        }
+        if self._thread_safety == ThreadSafety.CONCURRENT:
+            self._default_lock = contextlib.nullcontext()
+        else:
+            self._default_lock = self._status_lock
+            self._function_locks.update({function: self._command_lock for function in self._COMMAND_PATH_FUNCTIONS})
+        if self._thread_safety != ThreadSafety.SERIALIZED:
+            self._logger.info(f"Module {self._module_number}: API calls are locked as {self._thread_safety.value}")
+
+    @property
+    def thread_safety(self) -> ThreadSafety:
+        return self._thread_safety
+
     def _set_context(self):
         """
         Sets the context based on the module configuration.
@@ -85,8 +241,7 @@ class ExternalServerApiClient:
         else:
             config_struct = Config(None, 0)
 
-        with self._lock:
-            self._context = self._library.init(config_struct)
+        self._context = self._call_library("init", config_struct)
 
     def _type_all_function(self) -> None:
         """
@@ -124,14 +279,42 @@ class ExternalServerApiClient:
         self._library.destroy.restype = ct.c_int
         self._library.is_device_type_supported.argtypes = [ct.c_uint]
         self._library.is_device_type_supported.restype = ct.c_int
+        if hasattr(self._library, "forward_status_batch"):
+            self._library.forward_status_batch.argtypes = [
+                ct.POINTER(Buffer),
+                ct.POINTER(DeviceIdentification),
+                ct.c_size_t,
+                ct.c_void_p,
+            ]
+            self._library.forward_status_batch.restype = ct.c_int
+        if hasattr(self._library, "pop_command_into"):
+            self._library.pop_command_into.argtypes = [
+                ct.POINTER(Buffer),
+                ct.POINTER(DeviceIdentification),
+                ct.c_void_p,
+            ]
+            self._library.pop_command_into.restype = ct.c_int
+        if hasattr(self._library, "command_ack_batch"):
+            self._library.command_ack_batch.argtypes = [
+                ct.POINTER(Buffer),
+                ct.POINTER(DeviceIdentification),
+                ct.c_size_t,
+                ct.c_void_p,
+            ]
+            self._library.command_ack_batch.restype = ct.c_int
+        if hasattr(self._library, "get_thread_safety"):
+            self._library.get_thread_safety.argtypes = []
+            self._library.get_thread_safety.restype = ct.c_int
+        if hasattr(self._library, "register_command_callback"):
+            self._library.register_command_callback.argtypes = [CommandCallback, ct.c_void_p, ct.c_void_p]
+            self._library.register_command_callback.restype = ct.c_int
 
     def destroy(self) -> int:
         """
         Destroys the library and cleans up.
         """
-        with self._lock:
-            con = ct.c_void_p(self._context)
-            return self._library.destroy(ct.pointer(con))
+        con = ct.c_void_p(self._context)
+        return self._call_library("destroy", ct.pointer(con))
         
     def device_initialized(self) -> bool:
         """
@@ -147,6 +330,7 @@ class ExternalServerApiClient:
     def device_connected(self, device: internal_protocol.Device) -> int:
         """
         Handles device connection by creating the device identification and calling the library function.
+        If the device is connected successfully, its device identification is kept for next API calls.
 
         Parameters
         ----------
@@ -159,14 +343,17 @@ class ExternalServerApiClient:
             The result of the library function call.
         """
         device_identification = self._create_device_identification(device)
-        with self._lock:
-            return self._library.device_connected(device_identification, self._context)
+        rc = self._call_library("device_connected", device_identification, self._context)
+        if rc == GeneralErrorCodes.OK:
+            self._device_identifications[DeviceRegistry.key(device)] = device_identification
+        return rc
 
     def device_disconnected(
         self, disconnect_types: DisconnectTypes, device: internal_protocol.Device
     ) -> int:
         """
-        Handles device disconnection by creating the device identification and calling the library function.
+        Handles device disconnection by calling the library function. Kept device identification
+        of the device is released.
 
         Parameters
         ----------
@@ -181,11 +368,26 @@ class ExternalServerApiClient:
         int
             The result of the library function call.
         """
-        device_identification = self._create_device_identification(device)
-        with self._lock:
-            return self._library.device_disconnected(
-                disconnect_types, device_identification, self._context
-            )
+        device_identification = self._device_identifications.pop(DeviceRegistry.key(device), None)
+        if device_identification is None:
+            device_identification = self._create_device_identification(device)
+        return self._call_library(
+            "device_disconnected", disconnect_types, device_identification, self._context
+        )
+
+    def clear_device_identifications(self) -> None:
+        """Releases all kept device identifications."""
+        self._device_identifications.clear()
+
+    def _get_device_identification(self, device: internal_protocol.Device) -> DeviceIdentification:
+        """
+        Returns kept DeviceIdentification structure of connected device, structure is created
+        if the device is not connected.
+        """
+        device_identification = self._device_identifications.get(DeviceRegistry.key(device))
+        if device_identification is None:
+            return self._create_device_identification(device)
+        return device_identification
 
     def _create_device_identification(
         self, device: internal_protocol.Device
@@ -221,22 +423,21 @@ class ExternalServerApiClient:
         device.module = device_id.module
         device.priority = device_id.priority
         device.deviceType = device_id.device_type
-        if not device_id.device_role.data or device_id.device_role.size == 0:
-            device.deviceRole = ""
-        else:
-            device.deviceRole = device_id.device_role.data[: device_id.device_role.size].decode(
-                "utf-8"
-            )
-
-        if not device_id.device_name.data or device_id.device_name.size == 0:
-            device.deviceName = ""
-        else:
-            device.deviceName = device_id.device_name.data[: device_id.device_name.size].decode(
-                "utf-8"
-            )
-
+        device.deviceRole = self._buffer_bytes(device_id.device_role).decode("utf-8")
+        device.deviceName = self._buffer_bytes(device_id.device_name).decode("utf-8")
         return device
 
+    @staticmethod
+    def _buffer_bytes(buffer: Buffer) -> bytes:
+        """
+        Copies exactly buffer.size bytes of buffer data. Data can contain NUL bytes.
+        """
+        # Reading buffer.data would copy the data up to the first NUL byte
+        address = ct.c_void_p.from_buffer(buffer, Buffer.data.offset).value
+        if not address or buffer.size == 0:
+            return bytes()
+        return ct.string_at(address, buffer.size)
+
     def forward_status(self, device: internal_protocol.Device, status_bytes: bytes) -> int:
         """
         Forwards a status update by creating the device identification and status buffer,
@@ -255,10 +456,37 @@ class ExternalServerApiClient:
         int
             The result of the library function call.
         """
-        device_identification = self._create_device_identification(device)
+        if "forward_status" in self._native_functions:
+            return self._call_native("forward_status", device, status_bytes)
+        device_identification = self._get_device_identification(device)
         status_buffer = Buffer(data=status_bytes, size=len(status_bytes))
-        with self._lock:
-            return self._library.forward_status(status_buffer, device_identification, self._context)
+        return self._call_library("forward_status", status_buffer, device_identification, self._context)
+
+    def forward_statuses(self, statuses: list[tuple[internal_protocol.Device, bytes]]) -> int:
+        """
+        Forwards multiple status updates in one call of forward_status_batch library function.
+        If the library does not export forward_status_batch, forward_status is called for every status.
+
+        Parameters
+        ----------
+        statuses: list[tuple[internal_protocol.Device, bytes]]
+            Devices and bytes of their status messages in order of forwarding.
+
+        Returns
+        -------
+        int
+            The result of the batch function call. Without batch function OK if all calls
+            succeeded, else the result of the last failed call.
+        """
+        if not self._forward_status_batch_supported or len(statuses) == 1:
+            return self._call_for_each(self.forward_status, statuses)
+
+        if "forward_status_batch" in self._native_functions:
+            return self._call_native("forward_status_batch", statuses)
+        status_buffers, device_identifications = self._create_batch(statuses)
+        return self._call_library(
+            "forward_status_batch", status_buffers, device_identifications, len(statuses), self._context
+        )
 
     def forward_error_message(self, device: internal_protocol.Device, error_bytes: bytes) -> int:
         """
@@ -278,12 +506,11 @@ class ExternalServerApiClient:
         int
             The result of the library function call.
         """
-        device_identification = self._create_device_identification(device)
+        device_identification = self._get_device_identification(device)
         error_buffer = Buffer(data=error_bytes, size=len(error_bytes))
-        with self._lock:
-            return self._library.forward_error_message(
-                error_buffer, device_identification, self._context
-            )
+        return self._call_library(
+            "forward_error_message", error_buffer, device_identification, self._context
+        )
 
     def wait_for_command(self, timeout: int) -> int:
         """
@@ -299,11 +526,42 @@ class ExternalServerApiClient:
         int
             The result of the library function call.
         """
-        return self._library.wait_for_command(timeout, self._context)
+        return self._call_library("wait_for_command", timeout, self._context, lock=False)
+
+    @property
+    def command_callback_supported(self) -> bool:
+        """True if the library exports register_command_callback."""
+        return self._command_callback_supported
+
+    def register_command_callback(self, callback: Callable[[], None]) -> int:
+        """
+        Registers callback, which is called by the library from its own thread whenever
+        a command becomes available. The library must not call the callback after destroy.
+
+        Parameters
+        ----------
+        callback: Callable[[], None]
+            Function called when a command is available, exceptions raised by it are logged.
+
+        Returns
+        -------
+        int
+            The result of the library function call.
+        """
+        def command_callback(_user_data) -> None:
+            try:
+                callback()
+            except Exception as e:
+                self._logger.error(f"Error occurred in command callback: {e}")
+
+        self._command_callback = CommandCallback(command_callback)
+        return self._call_library("register_command_callback", self._command_callback, None, self._context)
 
     def pop_command(self) -> [bytes, internal_protocol.Device, int]:
         """
         Gets a command from the library by creating the device identification and calling the library function.
+        If the library exports pop_command_into, command is copied into buffers owned by this
+        client instead of buffers allocated by the library.
 
         Returns
         -------
@@ -316,37 +574,155 @@ class ExternalServerApiClient:
         int
             Return value of API function.
         """
+        if self._pop_command_into_supported:
+            return self._pop_command_into()
+
         command_buffer = Buffer(ct.c_char_p(), 0)
         device_identification = DeviceIdentification(
             0, 0, Buffer(ct.c_char_p(), 0), Buffer(ct.c_char_p()), 0
         )
-        with self._lock:
-            rc = self._library.pop_command(
-                ct.byref(command_buffer), ct.byref(device_identification), self._context
-            )
+        rc = self._call_library(
+            "pop_command", ct.byref(command_buffer), ct.byref(device_identification), self._context
+        )
         device = self._create_protobuf_device(device_identification)
+        command_bytes = self._buffer_bytes(command_buffer)
         self.deallocate(device_identification.device_role)
         self.deallocate(device_identification.device_name)
-        if not command_buffer or not command_buffer.data or command_buffer.size == 0:
-            command_bytes = bytes()
-        else:
-            command_bytes = bytes(command_buffer.data)[: command_buffer.size]
         self.deallocate(command_buffer)
 
         return command_bytes, device, rc
 
+    def _pop_command_into(self) -> [bytes, internal_protocol.Device, int]:
+        """
+        Gets a command from the library by calling pop_command_into with buffers owned by
+        this client. Library sets size of every buffer to size of copied data. If any buffer is
+        too small, library returns NOT_OK with required sizes and keeps the command, buffers
+        are then enlarged and the call is repeated. Command lock also guards the buffers, so it is
+        held even if the module is CONCURRENT.
+        """
+        with self._command_lock:
+            while True:
+                command_buffer = self._pop_command_storage.buffer()
+                device_identification = DeviceIdentification(
+                    0, 0, self._pop_device_role_storage.buffer(), self._pop_device_name_storage.buffer(), 0
+                )
+                rc = self._call_library(
+                    "pop_command_into",
+                    ct.byref(command_buffer),
+                    ct.byref(device_identification),
+                    self._context,
+                    lock=False,
+                )
+                if rc != GeneralErrorCodes.NOT_OK or not (
+                    self._pop_command_storage.reserve(command_buffer.size)
+                    | self._pop_device_role_storage.reserve(device_identification.device_role.size)
+                    | self._pop_device_name_storage.reserve(device_identification.device_name.size)
+                ):
+                    break
+
+            device = self._create_protobuf_device(device_identification)
+            command_bytes = self._buffer_bytes(command_buffer)
+
+        return command_bytes, device, rc
+
     def command_ack(self, command_data: bytes, device: internal_protocol.Device) -> int:
         """Calls command_ack function from API"""
-        device_id = self._create_device_identification(device)
-        with self._lock:
-            command_buffer = Buffer(command_data, len(command_data))
-            return self._library.command_ack(command_buffer, device_id, self._context)
+        device_id = self._get_device_identification(device)
+        command_buffer = Buffer(command_data, len(command_data))
+        return self._call_library("command_ack", command_buffer, device_id, self._context)
+
+    def command_acks(self, commands: list[tuple[bytes, internal_protocol.Device]]) -> int:
+        """
+        Acknowledges multiple commands in one call of command_ack_batch library function.
+        If the library does not export command_ack_batch, command_ack is called for every command.
+
+        Parameters
+        ----------
+        commands: list[tuple[bytes, internal_protocol.Device]]
+            Command data and devices of acknowledged commands in order of acknowledgement.
+
+        Returns
+        -------
+        int
+            The result of the batch function call. Without batch function OK if all calls
+            succeeded, else the result of the last failed call.
+        """
+        if not self._command_ack_batch_supported or len(commands) == 1:
+            return self._call_for_each(self.command_ack, commands)
+
+        command_buffers, device_identifications = self._create_batch(
+            [(device, command_data) for command_data, device in commands]
+        )
+        return self._call_library(
+            "command_ack_batch", command_buffers, device_identifications, len(commands), self._context
+        )
+
+    def _call_for_each(self, function, args_list: list[tuple]) -> int:
+        """Calls API wrapper function for every arguments tuple, returns OK or the last error."""
+        result = GeneralErrorCodes.OK
+        for args in args_list:
+            rc = function(*args)
+            if rc != GeneralErrorCodes.OK:
+                result = rc
+        return result
+
+    def _create_batch(
+        self, messages: list[tuple[internal_protocol.Device, bytes]]
+    ) -> tuple[ct.Array, ct.Array]:
+        """Creates arrays of Buffers and DeviceIdentifications for batch functions."""
+        buffers = (Buffer * len(messages))()
+        device_identifications = (DeviceIdentification * len(messages))()
+        for i, (device, data) in enumerate(messages):
+            buffers[i] = Buffer(data=data, size=len(data))
+            device_identifications[i] = self._get_device_identification(device)
+        return buffers, device_identifications
+
+    def _call_library(self, function_name: str, *args, lock: bool = True):
+        """
+        Calls API function and records its duration. The call is done under the lock of the
+        function by thread safety of the module unless lock is False, time spent waiting for
+        the lock is not recorded.
+        """
+        return self._call_timed(function_name, getattr(self._library, function_name), args, lock)
+
+    def _call_native(self, function_name: str, *args) -> int:
+        """
+        Calls API function by function of the native extension with the same name, which gets
+        address of the library function and the context before args. Locked and recorded same
+        as _call_library.
+        """
+        native_function = getattr(_fastpath, function_name)
+        return self._call_timed(
+            function_name, native_function, (self._native_functions[function_name], self._context, *args), True
+        )
+
+    def _call_timed(self, function_name: str, function: Callable, args: tuple, lock: bool):
+        histogram = self._call_histograms.get(function_name)
+        if histogram is None:
+            histogram = MetricsRegistry().histogram(
+                "external_server_module_call_seconds",
+                "Duration of module API function calls",
+                car=self._config["car_name"],
+                module=self._module_number,
+                function=function_name,
+            )
+            self._call_histograms[function_name] = histogram
+        if lock:
+            with self._function_locks.get(function_name, self._default_lock):
+                start = time.perf_counter()
+                result = function(*args)
+                histogram.observe(time.perf_counter() - start)
+        else:
+            start = time.perf_counter()
+            result = function(*args)
+            histogram.observe(time.perf_counter() - start)
+        return result
 
     def deallocate(self, buffer: Buffer) -> None:
-        self._library.deallocate(buffer)
+        self._call_library("deallocate", buffer, lock=False)
 
     def get_module_number(self) -> int:
-        return self._library.get_module_number()
+        return self._call_library("get_module_number", lock=False)
 
     def is_device_type_supported(self, device_type: int) -> int:
-        return self._library.is_device_type_supported(ct.c_uint(device_type))
+        return self._call_library("is_device_type_supported", ct.c_uint(device_type), lock=False)
@@ -0,0 +1,120 @@
+import atexit
+import json
+import logging
+import logging.handlers
+import queue
+import sys
+
+from external_server import constants
+from external_server.config import Config
+
+
+# Extra arguments of per-message log records, records of every category can be sampled by log_sampling
+STATUS_LOG = {"category": "status"}
+STATUS_RESPONSE_LOG = {"category": "status_response"}
+COMMAND_LOG = {"category": "command"}
+COMMAND_RESPONSE_LOG = {"category": "command_response"}
+
+
+class SamplingFilter(logging.Filter):
+    """Passes every n-th record of sampled categories
+
+    Records without category and records of WARNING level or higher always pass. Counters are
+    not locked, with records of one category logged from several threads the sampling is
+    approximate.
+
+    Args:
+    - rates (dict[str, int]): Every rates[category]-th record of the category passes.
+    """
+
+    def __init__(self, rates: dict[str, int]) -> None:
+        super().__init__()
+        self._rates = {category: rate for category, rate in rates.items() if rate > 1}
+        self._counts = dict.fromkeys(self._rates, 0)
+
+    def filter(self, record: logging.LogRecord) -> bool:
+        rate = self._rates.get(getattr(record, "category", None))
+        if rate is None or record.levelno >= logging.WARNING:
+            return True
+        count = self._counts[record.category]
+        self._counts[record.category] = count + 1
+        return count % rate == 0
+
+
+class JsonFormatter(logging.Formatter):
+    """Formats record as compact single line JSON object."""
+
+    def format(self, record: logging.LogRecord) -> str:
+        entry = {
+            "time": round(record.created, 6),
+            "level": record.levelname,
+            "logger": record.name,
+            "message": record.getMessage(),
+        }
+        category = getattr(record, "category", None)
+        if category is not None:
+            entry["category"] = category
+        if record.exc_info:
+            entry["exception"] = self.formatException(record.exc_info)
+        return json.dumps(entry, ensure_ascii=False, separators=(",", ":"))
+
+
+class LazyQueueHandler(logging.handlers.QueueHandler):
+    """Enqueues records without formatting, message is formatted by the listener thread
+
+    Records are passed within the process, so arguments of log calls are formatted later and
+    must not be changed after the call. Passing immutable values (numbers, strings) is safe.
+    """
+
+    def prepare(self, record: logging.LogRecord) -> logging.LogRecord:
+        return record
+
+
+def _create_handlers(config: Config) -> list[logging.Handler]:
+    if config.log_format == "json":
+        console_handler = logging.StreamHandler(sys.stderr)
+        console_handler.setFormatter(JsonFormatter())
+    else:
+        from rich.logging import RichHandler
+
+        console_handler = RichHandler()
+        console_handler.setFormatter(logging.Formatter("%(name)s: %(message)s", datefmt="[%X]"))
+    handlers = [console_handler]
+
+    if config.log_files_to_keep:
+        file_handler = logging.handlers.RotatingFileHandler(
+            filename=str(config.log_files_directory) + "/" + constants.LOG_FILE_NAME,
+            maxBytes=config.log_file_max_size_bytes,
+            backupCount=config.log_files_to_keep - 1,
+        )
+        file_handler.setFormatter(
+            JsonFormatter() if config.log_format == "json" else logging.Formatter(constants.LOG_FORMAT)
+        )
+        handlers.append(file_handler)
+    return handlers
+
+
+def setup_logging(config: Config) -> logging.handlers.QueueListener | None:
+    """Configures root logger by config.
+
+    With log_async, records are put to a queue and written by a listener thread, so logging
+    threads do not wait for formatting and output. Returned listener is stopped at exit, which
+    writes all queued records. Without log_async, None is returned.
+    """
+    handlers = _create_handlers(config)
+    root_logger = logging.getLogger()
+    root_logger.setLevel(logging.INFO)
+    if not config.log_async:
+        for handler in handlers:
+            # Every handler gets every record, so all of them sample the same records
+            handler.addFilter(SamplingFilter(config.log_sampling))
+            root_logger.addHandler(handler)
+        return None
+
+    queue_handler = LazyQueueHandler(queue.SimpleQueue())
+    queue_handler.addFilter(SamplingFilter(config.log_sampling))
+    root_logger.addHandler(queue_handler)
+    listener = logging.handlers.QueueListener(queue_handler.queue, *handlers, respect_handler_level=True)
+    listener.start()
+    atexit.register(listener.stop)
+    return listener
@@ -1,7 +1,5 @@
 import sys
 
-from external_server.structures import Buffer
-
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 import ExternalProtocol_pb2 as external_protocol
@@ -27,11 +25,9 @@ class MessageCreator:
         Returns:
             external_protocol.ExternalServer: An instance of the connect response message.
         """
-        connect_response = external_protocol.ConnectResponse()
-        connect_response.sessionId = session_id
-        connect_response.type = connect_response_type
         sent_msg = external_protocol.ExternalServer()
-        sent_msg.connectResponse.CopyFrom(connect_response)
+        sent_msg.connectResponse.sessionId = session_id
+        sent_msg.connectResponse.type = connect_response_type
         return sent_msg
 
     @staticmethod
@@ -48,12 +44,10 @@ class MessageCreator:
         Returns:
             external_protocol.ExternalServer: An instance of the status response message.
         """
-        status_response = external_protocol.StatusResponse()
-        status_response.sessionId = session_id
-        status_response.type = external_protocol.StatusResponse.Type.OK
-        status_response.messageCounter = message_counter
         sent_msg = external_protocol.ExternalServer()
-        sent_msg.statusResponse.CopyFrom(status_response)
+        sent_msg.statusResponse.sessionId = session_id
+        sent_msg.statusResponse.type = external_protocol.StatusResponse.Type.OK
+        sent_msg.statusResponse.messageCounter = message_counter
         return sent_msg
 
     @staticmethod
@@ -72,31 +66,83 @@ class MessageCreator:
         Returns:
             external_protocol.ExternalServer: An instance of the external command message.
         """
-        command = external_protocol.Command()
-        command.sessionId = session_id
-        command.messageCounter = counter
-        command.deviceCommand.CopyFrom(
-            MessageCreator._create_internal_command(device, command_data)
-        )
+        # Fields are filled in place, so command data is copied only once
         sent_msg = external_protocol.ExternalServer()
-        sent_msg.command.CopyFrom(command)
-        return sent_msg
-
-    @staticmethod
-    def _create_internal_command(
-        device: internal_protocol.Device, command_data: bytes | None
-    ) -> internal_protocol.DeviceCommand:
-        device_command = internal_protocol.DeviceCommand()
-
+        sent_msg.command.sessionId = session_id
+        sent_msg.command.messageCounter = counter
+        device_command = sent_msg.command.deviceCommand
         if device == None:
-            tmp_device = internal_protocol.Device()
-            device_command.device.CopyFrom(tmp_device)
+            device_command.device.SetInParent()
         else:
             device_command.device.CopyFrom(device)
+        device_command.commandData = bytes() if command_data == None else command_data
+        return sent_msg
+
+
+_WIRE_TYPE_VARINT = 0
+_WIRE_TYPE_LENGTH_DELIMITED = 2
+
+
+def _encode_varint(value: int) -> bytes:
+    encoded = bytearray()
+    while value > 0x7F:
+        encoded.append((value & 0x7F) | 0x80)
+        value >>= 7
+    encoded.append(value)
+    return bytes(encoded)
+
+
+def _encode_tag(message_type, field_name: str, wire_type: int) -> bytes:
+    field_number = message_type.DESCRIPTOR.fields_by_name[field_name].number
+    return _encode_varint(field_number << 3 | wire_type)
 
-        if command_data == None:
-            device_command.commandData = bytes()
-        else:
-            device_command.commandData = command_data
 
-        return device_command
+class StatusResponseSerializer:
+    """Serializes OK Status responses without creating protobuf messages
+
+    Produces the same bytes as serialized message created by MessageCreator.create_status_response.
+    Field numbers are taken from message descriptors. Serialized session id is cached, as all
+    responses of a session share it, so only the message counter is encoded for every response.
+    """
+
+    _STATUS_RESPONSE_TAG = _encode_tag(
+        external_protocol.ExternalServer, "statusResponse", _WIRE_TYPE_LENGTH_DELIMITED
+    )
+    _SESSION_ID_TAG = _encode_tag(external_protocol.StatusResponse, "sessionId", _WIRE_TYPE_LENGTH_DELIMITED)
+    _TYPE_TAG = _encode_tag(external_protocol.StatusResponse, "type", _WIRE_TYPE_VARINT)
+    _MESSAGE_COUNTER_TAG = _encode_tag(external_protocol.StatusResponse, "messageCounter", _WIRE_TYPE_VARINT)
+
+    __slots__ = ("_session_id", "_session_prefix")
+
+    def __init__(self) -> None:
+        self._session_id: str | None = None
+        self._session_prefix = bytes()
+
+    def serialize(self, session_id: str, message_counter: int) -> bytes:
+        """
+        Returns serialized ExternalServer message containing OK status response.
+
+        Args:
+            session_id (str): The session ID for the status response.
+            message_counter (int): The message counter for the status response.
+        """
+        if session_id != self._session_id:
+            self._session_prefix = self._serialize_session_prefix(session_id)
+            self._session_id = session_id
+        # Fields with default values are not serialized
+        status_response = (
+            self._session_prefix + self._MESSAGE_COUNTER_TAG + _encode_varint(message_counter)
+            if message_counter
+            else self._session_prefix
+        )
+        return self._STATUS_RESPONSE_TAG + _encode_varint(len(status_response)) + status_response
+
+    def _serialize_session_prefix(self, session_id: str) -> bytes:
+        prefix = bytes()
+        if session_id:
+            session_id_bytes = session_id.encode("utf-8")
+            prefix += self._SESSION_ID_TAG + _encode_varint(len(session_id_bytes)) + session_id_bytes
+        status_type = external_protocol.StatusResponse.Type.OK
+        if status_type:
+            prefix += self._TYPE_TAG + _encode_varint(status_type)
+        return prefix
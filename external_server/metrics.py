@@ -0,0 +1,272 @@
+import bisect
+import logging
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Callable
+
+from external_server.utils import SingletonMeta
+
+
+def _format_labels(labels: tuple[tuple[str, str], ...], extra: str = "") -> str:
+    items = [f'{key}="{value}"' for key, value in labels]
+    if extra:
+        items.append(extra)
+    return "{" + ",".join(items) + "}" if items else ""
+
+
+class Counter:
+    """Monotonically increasing value."""
+
+    __slots__ = ("_value", "_lock")
+
+    def __init__(self) -> None:
+        self._value = 0
+        self._lock = threading.Lock()
+
+    def inc(self, amount: int = 1) -> None:
+        with self._lock:
+            self._value += amount
+
+    @property
+    def value(self) -> int:
+        return self._value
+
+
+class Histogram:
+    """Histogram of durations in seconds with logarithmic buckets
+
+    Buckets are HDR-like, every power of two between MIN_VALUE and MAX_VALUE is split into
+    SUB_BUCKETS buckets of the same relative width, so the relative error of every recorded
+    value is below 2 ** (1 / SUB_BUCKETS) - 1 (cca 19 %).
+    """
+
+    MIN_VALUE = 1e-6
+    MAX_VALUE = 64.0
+    SUB_BUCKETS = 4
+    BOUNDS: list[float] = []
+
+    __slots__ = ("_counts", "_sum", "_count", "_lock")
+
+    def __init__(self) -> None:
+        self._counts = [0] * (len(self.BOUNDS) + 1)
+        self._sum = 0.0
+        self._count = 0
+        self._lock = threading.Lock()
+
+    def observe(self, value: float) -> None:
+        index = bisect.bisect_left(self.BOUNDS, value)
+        with self._lock:
+            self._counts[index] += 1
+            self._sum += value
+            self._count += 1
+
+    @property
+    def count(self) -> int:
+        return self._count
+
+    @property
+    def sum(self) -> float:
+        return self._sum
+
+    def quantile(self, q: float) -> float:
+        """Returns upper bound of the bucket containing q-quantile of recorded values, 0 if empty."""
+        with self._lock:
+            counts = list(self._counts)
+            count = self._count
+        if count == 0:
+            return 0.0
+        rank = q * count
+        cumulative = 0
+        for index, bucket_count in enumerate(counts):
+            cumulative += bucket_count
+            if cumulative >= rank and bucket_count:
+                return self.BOUNDS[index] if index < len(self.BOUNDS) else float("inf")
+        return float("inf")
+
+    def buckets(self) -> list[tuple[float, int]]:
+        """Returns cumulative counts of values less or equal to bucket bounds, last bound is inf."""
+        with self._lock:
+            counts = list(self._counts)
+        cumulative = 0
+        result = []
+        for bound, bucket_count in zip(self.BOUNDS + [float("inf")], counts):
+            cumulative += bucket_count
+            result.append((bound, cumulative))
+        return result
+
+
+def _histogram_bounds() -> list[float]:
+    bounds = []
+    bound = Histogram.MIN_VALUE
+    while bound <= Histogram.MAX_VALUE:
+        bounds.append(bound)
+        bound *= 2 ** (1 / Histogram.SUB_BUCKETS)
+    return bounds
+
+
+Histogram.BOUNDS = _histogram_bounds()
+
+
+class MetricsRegistry(metaclass=SingletonMeta):
+    """Registry of all metrics of External server
+
+    Metrics are identified by name and labels, getting metric with the same name and labels
+    returns the same instance. Registry renders all metrics in Prometheus text format.
+    """
+
+    def __init__(self) -> None:
+        self._lock = threading.Lock()
+        self._help: dict[str, tuple[str, str]] = dict()
+        self._counters: dict[tuple[str, tuple], Counter] = dict()
+        self._histograms: dict[tuple[str, tuple], Histogram] = dict()
+        self._gauges: dict[tuple[str, tuple], Callable[[], float]] = dict()
+        self._readiness_checks: dict[str, Callable[[], bool]] = dict()
+
+    def counter(self, name: str, help: str, **labels: str) -> Counter:
+        return self._get(self._counters, Counter, name, help, "counter", labels)
+
+    def histogram(self, name: str, help: str, **labels: str) -> Histogram:
+        return self._get(self._histograms, Histogram, name, help, "histogram", labels)
+
+    def gauge(self, name: str, help: str, function: Callable[[], float], **labels: str) -> None:
+        """Registers gauge, which value is returned by function when metrics are rendered.
+        Function registered earlier with the same name and labels is replaced."""
+        self._register_function(name, help, "gauge", function, labels)
+
+    def function_counter(self, name: str, help: str, function: Callable[[], float], **labels: str) -> None:
+        """Registers counter, which value is returned by function when metrics are rendered.
+        Function registered earlier with the same name and labels is replaced."""
+        self._register_function(name, help, "counter", function, labels)
+
+    def _register_function(
+        self, name: str, help: str, type_name: str, function: Callable[[], float], labels: dict
+    ) -> None:
+        with self._lock:
+            self._help[name] = (help, type_name)
+            self._gauges[(name, tuple(sorted(labels.items())))] = function
+
+    def remove_gauge(self, name: str, **labels: str) -> None:
+        with self._lock:
+            self._gauges.pop((name, tuple(sorted(labels.items()))), None)
+
+    def readiness_check(self, name: str, function: Callable[[], bool]) -> None:
+        """Registers function returning True if the named component is ready to handle cars."""
+        with self._lock:
+            self._readiness_checks[name] = function
+
+    def remove_readiness_check(self, name: str) -> None:
+        with self._lock:
+            self._readiness_checks.pop(name, None)
+
+    def readiness(self) -> dict[str, bool]:
+        """Returns readiness of all registered components."""
+        with self._lock:
+            checks = list(self._readiness_checks.items())
+        return {name: bool(function()) for name, function in checks}
+
+    def _get(self, metrics: dict, metric_type: type, name: str, help: str, type_name: str, labels: dict):
+        key = (name, tuple(sorted(labels.items())))
+        with self._lock:
+            metric = metrics.get(key)
+            if metric is None:
+                metric = metric_type()
+                metrics[key] = metric
+                self._help[name] = (help, type_name)
+            return metric
+
+    def render(self) -> str:
+        """Returns all metrics in Prometheus text exposition format."""
+        with self._lock:
+            counters = list(self._counters.items())
+            histograms = list(self._histograms.items())
+            gauges = list(self._gauges.items())
+            help = dict(self._help)
+
+        lines: list[str] = []
+        written_headers: set[str] = set()
+
+        def header(name: str) -> None:
+            if name not in written_headers:
+                written_headers.add(name)
+                help_text, type_name = help[name]
+                lines.append(f"# HELP {name} {help_text}")
+                lines.append(f"# TYPE {name} {type_name}")
+
+        for (name, labels), counter in sorted(counters, key=lambda item: item[0]):
+            header(name)
+            lines.append(f"{name}{_format_labels(labels)} {counter.value}")
+        for (name, labels), function in sorted(gauges, key=lambda item: item[0]):
+            header(name)
+            try:
+                value = function()
+            except Exception:
+                continue
+            lines.append(f"{name}{_format_labels(labels)} {value}")
+        for (name, labels), histogram in sorted(histograms, key=lambda item: item[0]):
+            header(name)
+            for bound, count in histogram.buckets():
+                le = "+Inf" if bound == float("inf") else f"{bound:.9g}"
+                le_label = f'le="{le}"'
+                lines.append(f"{name}_bucket{_format_labels(labels, le_label)} {count}")
+            lines.append(f"{name}_sum{_format_labels(labels)} {histogram.sum}")
+            lines.append(f"{name}_count{_format_labels(labels)} {histogram.count}")
+        return "\n".join(lines) + "\n"
+
+
+class MetricsServer:
+    """HTTP server providing metrics from MetricsRegistry on /metrics path
+
+    Path /health responds 200 while the process is running. Path /ready responds 200 if all
+    readiness checks registered in MetricsRegistry pass, else 503; with no registered check
+    the server is not ready yet.
+
+    Args:
+    - port (int): The port the server listens on.
+    """
+
+    def __init__(self, port: int) -> None:
+        self._logger = logging.getLogger(self.__class__.__name__)
+        self._port = port
+        self._server: ThreadingHTTPServer | None = None
+        self._thread: threading.Thread | None = None
+
+    def start(self) -> None:
+        """Starts serving metrics in a daemon thread."""
+        self._server = ThreadingHTTPServer(("", self._port), _MetricsRequestHandler)
+        self._server.daemon_threads = True
+        self._thread = threading.Thread(target=self._server.serve_forever, name=self.__class__.__name__, daemon=True)
+        self._thread.start()
+        self._logger.info(f"Serving metrics on port {self._port}")
+
+    def stop(self) -> None:
+        if self._server is not None:
+            self._server.shutdown()
+            self._server.server_close()
+            self._server = None
+
+
+class _MetricsRequestHandler(BaseHTTPRequestHandler):
+    def do_GET(self) -> None:
+        path = self.path.split("?")[0]
+        if path == "/metrics":
+            self._respond(200, MetricsRegistry().render(), "text/plain; version=0.0.4; charset=utf-8")
+        elif path == "/health":
+            self._respond(200, "ok\n", "text/plain; charset=utf-8")
+        elif path == "/ready":
+            readiness = MetricsRegistry().readiness()
+            body = "".join(f"{name}: {'ready' if ready else 'not ready'}\n" for name, ready in readiness.items())
+            ready = bool(readiness) and all(readiness.values())
+            self._respond(200 if ready else 503, body or "not ready\n", "text/plain; charset=utf-8")
+        else:
+            self.send_error(404)
+
+    def _respond(self, status: int, text: str, content_type: str) -> None:
+        body = text.encode("utf-8")
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format: str, *args) -> None:
+        pass
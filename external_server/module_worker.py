@@ -0,0 +1,187 @@
+import collections
+import logging
+import threading
+from concurrent.futures import Future
+from dataclasses import dataclass, field
+from typing import Any, Callable
+
+from external_server import constants
+from external_server.structures import Backpressure
+from external_server.metrics import MetricsRegistry
+
+
+@dataclass(slots=True, eq=False)
+class _Call:
+    function: Callable[..., Any]
+    args: tuple
+    droppable: bool
+    future: Future = field(default_factory=Future)
+
+
+class ModuleWorker:
+    """Calls API functions of one module from its own thread in order of submission
+
+    Main loop submits calls to the dispatch queue and continues without waiting for the module,
+    so a slow module delays only its own calls. Calls of a module are made in the order they were
+    submitted, which keeps the order of statuses, connections and disconnections of every device.
+
+    Queue holds at most queue_size calls, backpressure decides what happens to a droppable call
+    (status batch) submitted to full queue. Other calls (connections, disconnections, command
+    acknowledgements) are never dropped; with BLOCK policy they wait for free space, with other
+    policies they are queued over the limit. Under DROP_OLDEST policy, status batch submitted to
+    full queue without queued status batch waits for free space.
+
+    Args:
+    - module_num (int): Number of the module, used in logs and metrics.
+    - queue_size (int): Maximum number of calls waiting in the queue.
+    - backpressure (Backpressure): Handling of droppable call submitted to full queue.
+    - car_name (str): Name of the car, used in metrics.
+    """
+
+    def __init__(
+        self,
+        module_num: int,
+        queue_size: int = constants.MODULE_QUEUE_SIZE,
+        backpressure: Backpressure = Backpressure.BLOCK,
+        car_name: str = "",
+    ) -> None:
+        self._logger = logging.getLogger(f"{self.__class__.__name__}({module_num})")
+        self._module_num = module_num
+        self._queue_size = queue_size
+        self._backpressure = backpressure
+        self._queue: collections.deque[_Call] = collections.deque()
+        self._condition = threading.Condition()
+        self._busy = False
+        self._running = False
+        self._thread: threading.Thread | None = None
+
+        registry = MetricsRegistry()
+        self._backpressure_events = registry.counter(
+            "external_server_module_backpressure_total",
+            "Number of status batches submitted to full dispatch queue of the module",
+            car=car_name,
+            module=str(module_num),
+        )
+        self._dropped_batches = registry.counter(
+            "external_server_module_dropped_status_batches_total",
+            "Number of status batches discarded from dispatch queue of the module",
+            car=car_name,
+            module=str(module_num),
+        )
+        self._metric_labels = {"car": car_name, "module": str(module_num)}
+        registry.gauge(
+            "external_server_module_queue_depth",
+            "Number of API calls waiting in dispatch queue of the module",
+            self.__len__,
+            **self._metric_labels,
+        )
+
+    def __len__(self) -> int:
+        return len(self._queue)
+
+    def start(self) -> None:
+        with self._condition:
+            if self._running:
+                return
+            self._running = True
+        self._thread = threading.Thread(target=self._main_thread, name=f"Module{self._module_num}", daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        """Makes all queued calls and stops the thread."""
+        with self._condition:
+            self._running = False
+            self._condition.notify_all()
+        if self._thread is not None:
+            self._thread.join()
+            self._thread = None
+        MetricsRegistry().remove_gauge("external_server_module_queue_depth", **self._metric_labels)
+
+    def submit(self, function: Callable[..., Any], *args: Any, droppable: bool = False) -> Future | None:
+        """Queues call of function with args, returns future of its result.
+
+        Returns None if the droppable call is rejected by DISCONNECT policy because the queue is full.
+        Future of call discarded by DROP_OLDEST policy is cancelled.
+        """
+        call = _Call(function, args, droppable)
+        if not self._running:
+            # Calls are made directly while the thread is not running, e.g. before server start
+            self._process(call)
+            return call.future
+        with self._condition:
+            if len(self._queue) >= self._queue_size:
+                if droppable:
+                    self._backpressure_events.inc()
+                if self._backpressure == Backpressure.DISCONNECT:
+                    if droppable:
+                        self._dropped_batches.inc()
+                        self._logger.error(f"Dispatch queue is full, module {self._module_num} is stalled")
+                        return None
+                elif self._backpressure == Backpressure.DROP_OLDEST:
+                    # Only status batch makes space for itself, it waits if there is no queued batch to discard
+                    if droppable and not self._drop_oldest():
+                        self._wait_for_space()
+                else:
+                    self._wait_for_space()
+            self._queue.append(call)
+            self._condition.notify_all()
+        return call.future
+
+    def call(self, function: Callable[..., Any], *args: Any) -> Any:
+        """Makes call of function with args after all queued calls and returns its result."""
+        future = self.submit(function, *args)
+        assert future is not None
+        return future.result()
+
+    def drain(self) -> None:
+        """Waits until all queued calls are made."""
+        with self._condition:
+            self._condition.wait_for(lambda: not (self._queue or self._busy) or self._thread is None)
+
+    def drop_statuses(self) -> int:
+        """Discards all queued droppable calls, returns their number."""
+        with self._condition:
+            dropped = [call for call in self._queue if call.droppable]
+            self._queue = collections.deque(call for call in self._queue if not call.droppable)
+            self._condition.notify_all()
+        for call in dropped:
+            call.future.cancel()
+        self._dropped_batches.inc(len(dropped))
+        return len(dropped)
+
+    def _wait_for_space(self) -> None:
+        """Waits until the queue is not full or the worker is stopped, must be called with the condition held."""
+        self._condition.wait_for(lambda: len(self._queue) < self._queue_size or not self._running)
+
+    def _drop_oldest(self) -> bool:
+        """Discards the oldest queued droppable call, must be called with the condition held."""
+        for index, call in enumerate(self._queue):
+            if call.droppable:
+                del self._queue[index]
+                call.future.cancel()
+                self._dropped_batches.inc()
+                self._logger.warning(f"Dispatch queue is full, oldest status batch of module {self._module_num} dropped")
+                return True
+        return False
+
+    def _main_thread(self) -> None:
+        while True:
+            with self._condition:
+                self._busy = False
+                self._condition.notify_all()
+                self._condition.wait_for(lambda: self._queue or not self._running)
+                if not self._queue:
+                    return
+                call = self._queue.popleft()
+                self._busy = True
+                self._condition.notify_all()
+            self._process(call)
+
+    def _process(self, call: _Call) -> None:
+        if not call.future.set_running_or_notify_cancel():
+            return
+        try:
+            call.future.set_result(call.function(*call.args))
+        except Exception as e:
+            self._logger.error(f"Module {self._module_num}: Error occurred in API call: {e}")
+            call.future.set_exception(e)
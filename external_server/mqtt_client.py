@@ -1,7 +1,10 @@
 import logging
 import random
+import re
 import string
-from queue import Queue, Empty
+import threading
+import time
+from typing import Callable
 import sys
 import ssl
 
@@ -11,41 +14,76 @@ from paho.mqtt.enums import CallbackAPIVersion
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 import ExternalProtocol_pb2 as external_protocol
-from external_server.event_queue import EventQueueSingleton, EventType
+from external_server.codec import Compression, PayloadCodec
+from external_server.event_queue import EventQueue, EventQueueSingleton, EventType
+from external_server.exceptions import PayloadDecodeError
+from external_server.metrics import MetricsRegistry
+from external_server.structures import EventPriority
+from external_server.transport import Transport
 import external_server.constants as constants
 
-class MqttClient:
+
+class MqttClient(Transport):
     """
     A class representing an MQTT client.
 
     Args:
     - company_name (str): The name of the company.
     - car_name (str): The name of the car.
+    - event_queue (EventQueue | None): The queue for events, EventQueueSingleton if not given.
+    - max_queued_messages (int): Maximum number of messages in outgoing queue, 0 means unlimited.
+    - max_inflight_messages (int): Maximum number of QoS 1 messages waiting for broker acknowledgement.
+    - adaptive_queue (bool): If True, queue limits grow with number of connected devices
+        given by set_device_count, limits given above are used as minimums.
+    - codec (PayloadCodec | None): Codec of published and received payloads, payloads are never
+        compressed if not given.
 
     Attributes:
     - publish_topic (str): The topic to publish messages to.
-    - received_msgs (Queue[external_protocol.ExternalClient]): A queue to store received messages.
     - mqtt_client (mqtt.Client): The MQTT client instance.
     - _is_connected (bool): Indicates whether the client is connected to the MQTT broker.
     """
 
-    def __init__(self, company_name: str, car_name: str) -> None:
+    def __init__(
+        self,
+        company_name: str,
+        car_name: str,
+        event_queue: EventQueue | None = None,
+        max_queued_messages: int = constants.MAX_QUEUED_MESSAGES,
+        max_inflight_messages: int = constants.MAX_INFLIGHT_MESSAGES,
+        adaptive_queue: bool = False,
+        codec: PayloadCodec | None = None,
+    ) -> None:
+        super().__init__(event_queue if event_queue is not None else EventQueueSingleton())
         self._logger = logging.getLogger(self.__class__.__name__)
 
+        self._codec = codec if codec is not None else PayloadCodec()
         self._publish_topic = f"{company_name}/{car_name}/external_server"
         self._subscribe_topic = f"{company_name}/{car_name}/module_gateway"
-        self._received_msgs: Queue[external_protocol.ExternalClient] = Queue()
         self._mqtt_client = mqtt.Client(
             callback_api_version=CallbackAPIVersion.VERSION1,
             client_id="".join(random.choices(string.ascii_uppercase + string.digits, k=20)),
             protocol=mqtt.MQTTv311,
             reconnect_on_failure=True
         )
-        # TODO reason these values
-        self._mqtt_client.max_queued_messages_set(constants.MAX_QUEUED_MESSAGES)
+        self._max_queued_messages = max_queued_messages
+        self._max_inflight_messages = max_inflight_messages
+        self._adaptive_queue = adaptive_queue
+        # Limit of outgoing queue is applied by _publish, paho's limit would apply to all publishers
+        # of the shared client, including high priority messages
+        self._mqtt_client.max_queued_messages_set(0)
+        self._mqtt_client.max_inflight_messages_set(max_inflight_messages)
+        # Current limit of outgoing queue, 0 means unlimited, high priority messages are queued over it
+        self._queued_messages_limit = max_queued_messages
+
+        self._queued_messages = 0
+        self._queued_messages_high_water_mark = 0
+        self._dropped_messages = 0
+        # Guards the counters and the limit, so that messages are admitted to the queue one by one
+        self._queue_counters_lock = threading.Lock()
 
-        self._event_queue = EventQueueSingleton()
         self._is_connected = False
+        self._metrics_labels: dict[str, str] | None = None
 
     def set_tls(self, ca_certs: str, certfile: str, keyfile: str) -> None:
         """
@@ -73,6 +111,7 @@ class MqttClient:
         self._mqtt_client.on_connect = self._on_connect
         self._mqtt_client.on_disconnect = self._on_disconnect
         self._mqtt_client.on_message = self._on_message
+        self._mqtt_client.on_publish = self._on_publish
 
     def _on_connect(self, client, _userdata, _flags, _rc):
         """
@@ -102,7 +141,6 @@ class MqttClient:
         self._is_connected = False
         self._logger.info("Server disconnected from MQTT broker")
 
-        self._received_msgs.put(False)
         self._event_queue.add_event(event_type=EventType.MQTT_BROKER_DISCONNECTED)
 
     def _on_message(self, _client: mqtt.Client, _userdata, message: mqtt.MQTTMessage) -> None:
@@ -116,9 +154,46 @@ class MqttClient:
         """
         if message.topic != self._subscribe_topic:
             return
-        message_external_client = external_protocol.ExternalClient().FromString(message.payload)
-        self._received_msgs.put(message_external_client)
-        self._event_queue.add_event(event_type=EventType.RECEIVED_MESSAGE)
+        received_at = time.monotonic()
+        decoded = self._decode(message)
+        if decoded is None:
+            return
+        message_external_client, compression = decoded
+        if message_external_client.HasField("connect"):
+            compression = self._codec.negotiate(compression)
+        else:
+            compression = Compression.NONE
+        self._event_queue.add_event(
+            event_type=EventType.RECEIVED_MESSAGE, data=(message_external_client, received_at, compression)
+        )
+
+    def _decode(
+        self, message: mqtt.MQTTMessage
+    ) -> tuple[external_protocol.ExternalClient, Compression] | None:
+        """
+        Decode received payload, returns the message and compression of the payload, None if payload
+        could not be decompressed.
+        """
+        try:
+            payload, compression = self._codec.decode(message.payload)
+        except PayloadDecodeError as e:
+            self._logger.warning(f"Message received on {message.topic} was dropped: {e}")
+            return None
+        return external_protocol.ExternalClient().FromString(payload), compression
+
+    @property
+    def codec(self) -> PayloadCodec:
+        """
+        Codec of published and received payloads.
+        """
+        return self._codec
+
+    def _on_publish(self, _client: mqtt.Client, _userdata, _mid: int) -> None:
+        """
+        Callback function for handling message leaving the outgoing queue (acknowledged by broker for QoS 1).
+        """
+        with self._queue_counters_lock:
+            self._queued_messages = max(0, self._queued_messages - 1)
 
     def connect(self, ip_address: str, port: int) -> None:
         """
@@ -143,27 +218,129 @@ class MqttClient:
         self._mqtt_client.loop_stop()
         self._is_connected = False
 
-    def publish(self, msg: external_protocol.ExternalServer) -> None:
+    def publish(self, msg: external_protocol.ExternalServer, priority: EventPriority = EventPriority.NORMAL) -> None:
         """
         Publish a message to the MQTT broker.
 
         Args:
         - msg (external_protocol.ExternalServer): The message to publish.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
         """
-        self._mqtt_client.publish(self._publish_topic, msg.SerializeToString(), qos=constants.QOS)
+        self._publish(self._publish_topic, self._codec.encode(msg.SerializeToString(), self._compression), priority)
 
-    def get(self, timeout: int | None = None) -> external_protocol.ExternalClient | None:
-        """Returns message from MqttClient
-        Parameters
-        ----------
-        timeout:int
-            Timeout to wait for received message. If timeout is None, function blocks
-                until message is available.
+    def publish_serialized(self, payload: bytes, priority: EventPriority = EventPriority.NORMAL) -> None:
         """
-        try:
-            return self._received_msgs.get(block=True, timeout=timeout)
-        except Empty:
-            return None
+        Publish an already serialized message to the MQTT broker.
+
+        Args:
+        - payload (bytes): The serialized external_protocol.ExternalServer message.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+        self._publish(self._publish_topic, self._codec.encode(payload, self._compression), priority)
+
+    def _publish(self, topic: str, payload: bytes, priority: EventPriority = EventPriority.NORMAL) -> None:
+        with self._queue_counters_lock:
+            # Queue is FIFO, so high priority message can not overtake queued messages, but it is not dropped
+            admitted = (
+                self._queued_messages_limit == 0
+                or self._queued_messages < self._queued_messages_limit
+                or priority == EventPriority.HIGH
+            )
+            if admitted:
+                # Counted before publishing, so that the message is not acknowledged by broker before it is counted
+                self._queued_messages += 1
+                self._queued_messages_high_water_mark = max(
+                    self._queued_messages_high_water_mark, self._queued_messages
+                )
+            else:
+                self._dropped_messages += 1
+        if not admitted:
+            self._logger.warning(f"Outgoing queue is full, message to {topic} was dropped")
+            return
+        self._mqtt_client.publish(topic, payload, qos=constants.QOS)
+
+    def set_device_count(self, device_count: int) -> None:
+        """
+        Resize outgoing queue and in-flight window according to number of connected devices.
+        Has no effect if adaptive queue is disabled.
+
+        Args:
+        - device_count (int): Number of devices, which are communicating through this client.
+        """
+        if not self._adaptive_queue:
+            return
+        if self._max_queued_messages > 0:
+            with self._queue_counters_lock:
+                self._queued_messages_limit = max(
+                    self._max_queued_messages, device_count * constants.QUEUED_MESSAGES_PER_DEVICE
+                )
+        self._mqtt_client.max_inflight_messages_set(
+            max(self._max_inflight_messages, device_count * constants.INFLIGHT_MESSAGES_PER_DEVICE)
+        )
+
+    @property
+    def queued_messages(self) -> int:
+        """
+        Number of published messages, which have not left the outgoing queue yet.
+        """
+        return self._queued_messages
+
+    @property
+    def queued_messages_high_water_mark(self) -> int:
+        """
+        Highest number of messages in the outgoing queue since the client was created.
+        """
+        return self._queued_messages_high_water_mark
+
+    @property
+    def dropped_messages(self) -> int:
+        """
+        Number of messages dropped because the outgoing queue was full.
+        """
+        return self._dropped_messages
+
+    def register_metrics(self, **labels: str) -> None:
+        """
+        Register outgoing queue counters of the client to MetricsRegistry.
+
+        Args:
+        - labels: Labels of the registered metrics.
+        """
+        registry = MetricsRegistry()
+        registry.gauge(
+            "external_server_mqtt_queued_messages",
+            "Number of messages in MQTT outgoing queue",
+            lambda: self.queued_messages,
+            **labels,
+        )
+        registry.gauge(
+            "external_server_mqtt_queued_messages_high_water_mark",
+            "Highest number of messages in MQTT outgoing queue",
+            lambda: self.queued_messages_high_water_mark,
+            **labels,
+        )
+        registry.function_counter(
+            "external_server_mqtt_dropped_messages_total",
+            "Number of messages dropped because MQTT outgoing queue was full",
+            lambda: self.dropped_messages,
+            **labels,
+        )
+        self._metrics_labels = labels
+
+    def remove_metrics(self) -> None:
+        """
+        Remove metrics registered by register_metrics from MetricsRegistry.
+        """
+        if self._metrics_labels is None:
+            return
+        registry = MetricsRegistry()
+        for name in (
+            "external_server_mqtt_queued_messages",
+            "external_server_mqtt_queued_messages_high_water_mark",
+            "external_server_mqtt_dropped_messages_total",
+        ):
+            registry.remove_gauge(name, **self._metrics_labels)
+        self._metrics_labels = None
 
     @property
     def is_connected(self) -> bool:
@@ -174,3 +351,275 @@ class MqttClient:
         - bool: True if connected, False otherwise.
         """
         return self._is_connected
+
+
+class MultiCarMqttClient(MqttClient):
+    """
+    An MQTT client shared by all cars of one company in multi-car mode.
+
+    Subscribes to module gateway topics of all cars of the company (company/+/module_gateway)
+    and routes every received message to the CarMqttClient of the car named in the topic.
+    The CarMqttClient is obtained from the on_new_car callback when the first message of
+    the car is received.
+
+    Args:
+    - company_name (str): The name of the company.
+    - on_new_car (Callable[[str], CarMqttClient | None]): Called with the car name when a message
+        from a car without CarMqttClient is received. Returns None if the car is refused.
+    """
+
+    _CAR_NAME_PATTERN = re.compile(r"^[a-z0-9_]*$")
+
+    def __init__(
+        self,
+        company_name: str,
+        on_new_car: Callable[[str], "CarMqttClient | None"],
+        max_queued_messages: int = constants.MAX_QUEUED_MESSAGES,
+        max_inflight_messages: int = constants.MAX_INFLIGHT_MESSAGES,
+        adaptive_queue: bool = False,
+        codec: PayloadCodec | None = None,
+    ) -> None:
+        super().__init__(
+            company_name,
+            "+",
+            max_queued_messages=max_queued_messages,
+            max_inflight_messages=max_inflight_messages,
+            adaptive_queue=adaptive_queue,
+            codec=codec,
+        )
+        self._on_new_car = on_new_car
+        self._car_device_counts: dict[str, int] = dict()
+        self._car_clients: dict[str, CarMqttClient] = dict()
+        self._car_clients_lock = threading.Lock()
+        self._connected = threading.Event()
+
+    def _on_connect(self, client, _userdata, _flags, _rc):
+        super()._on_connect(client, _userdata, _flags, _rc)
+        self._connected.set()
+
+    def _on_disconnect(self, _client, _userdata, ret_code) -> None:
+        """
+        Callback function for handling disconnection events. Disconnection is announced to all cars.
+        """
+        self._is_connected = False
+        self._connected.clear()
+        self._logger.info("Server disconnected from MQTT broker")
+
+        with self._car_clients_lock:
+            car_clients = list(self._car_clients.values())
+        for car_client in car_clients:
+            car_client.broker_disconnected()
+
+    def _on_message(self, _client: mqtt.Client, _userdata, message: mqtt.MQTTMessage) -> None:
+        """
+        Callback function for handling incoming messages. The message is routed to the car
+        named in the message topic.
+        """
+        if not mqtt.topic_matches_sub(self._subscribe_topic, message.topic):
+            return
+        car_client = self._get_car_client(message.topic.split("/")[1])
+        if car_client is None:
+            return
+        decoded = self._decode(message)
+        if decoded is not None:
+            car_client.put(*decoded)
+
+    def _get_car_client(self, car_name: str) -> "CarMqttClient | None":
+        with self._car_clients_lock:
+            if car_name in self._car_clients:
+                return self._car_clients[car_name]
+            if not self._CAR_NAME_PATTERN.match(car_name):
+                self._logger.warning(f"Received message from car with invalid name '{car_name}', ignoring it")
+                return None
+            car_client = self._on_new_car(car_name)
+            if car_client is not None:
+                self._car_clients[car_name] = car_client
+            return car_client
+
+    def remove_car(self, car_name: str, car_client: "CarMqttClient") -> None:
+        """
+        Forget client of a car, next message of the car creates a new one.
+
+        Args:
+        - car_name (str): The name of the car.
+        - car_client (CarMqttClient): The removed client, a newer client of the car is kept.
+        """
+        with self._car_clients_lock:
+            if self._car_clients.get(car_name) is not car_client:
+                return
+            del self._car_clients[car_name]
+            self._car_device_counts.pop(car_name, None)
+            total_device_count = sum(self._car_device_counts.values())
+        self.set_device_count(total_device_count)
+
+    def wait_for_connection(self, timeout: float | None = None) -> bool:
+        """
+        Block until the client is connected to the MQTT broker.
+
+        Args:
+        - timeout (float | None): Maximum time to wait in seconds, None waits indefinitely.
+
+        Returns:
+        - bool: True if connected, False if timeout expired.
+        """
+        return self._connected.wait(timeout)
+
+    def publish_to(
+        self, topic: str, msg: external_protocol.ExternalServer, priority: EventPriority = EventPriority.NORMAL
+    ) -> None:
+        """
+        Publish a message to the given topic.
+
+        Args:
+        - topic (str): The topic to publish the message to.
+        - msg (external_protocol.ExternalServer): The message to publish.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+        self._publish(topic, msg.SerializeToString(), priority)
+
+    def publish_serialized_to(self, topic: str, payload: bytes, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish an already serialized message to the given topic. The payload is not encoded
+        by codec, compression is negotiated per car by CarMqttClient.
+
+        Args:
+        - topic (str): The topic to publish the message to.
+        - payload (bytes): The serialized external_protocol.ExternalServer message.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+        self._publish(topic, payload, priority)
+
+    def set_car_device_count(self, car_name: str, device_count: int) -> None:
+        """
+        Resize outgoing queue according to number of connected devices of all cars.
+
+        Args:
+        - car_name (str): The name of the car.
+        - device_count (int): Number of devices of the car.
+        """
+        with self._car_clients_lock:
+            self._car_device_counts[car_name] = device_count
+            total_device_count = sum(self._car_device_counts.values())
+        self.set_device_count(total_device_count)
+
+
+class CarMqttClient(Transport):
+    """
+    A view of MultiCarMqttClient for a single car.
+
+    Provides the same interface as MqttClient to the ExternalServer handling the car. Connection
+    to the MQTT broker is owned by the shared MultiCarMqttClient, so connect only waits for
+    the shared connection and start and stop do not affect it.
+
+    Args:
+    - shared_client (MultiCarMqttClient): The client connected to the MQTT broker.
+    - company_name (str): The name of the company.
+    - car_name (str): The name of the car.
+    - event_queue (EventQueue): The queue for events of the car.
+    """
+
+    def __init__(
+        self, shared_client: MultiCarMqttClient, company_name: str, car_name: str, event_queue: EventQueue
+    ) -> None:
+        super().__init__(event_queue)
+        self._shared_client = shared_client
+        self._car_name = car_name
+        self._publish_topic = f"{company_name}/{car_name}/external_server"
+        self._closed = False
+
+    def init(self) -> None:
+        """
+        Callbacks are set on the shared client, nothing to initialize.
+        """
+        pass
+
+    def connect(self, _ip_address: str, _port: int) -> None:
+        """
+        Wait for the shared client to connect to the MQTT broker.
+
+        Raises:
+        - ConnectionRefusedError: If the shared client is not connected within keepalive period.
+        """
+        if not self._shared_client.wait_for_connection(constants.KEEPALIVE):
+            raise ConnectionRefusedError()
+
+    def start(self) -> None:
+        """
+        Event loop is run by the shared client.
+        """
+        pass
+
+    def stop(self) -> None:
+        """
+        Event loop is run by the shared client, connection of other cars is not affected.
+        """
+        pass
+
+    def put(self, msg: external_protocol.ExternalClient, compression: Compression = Compression.NONE) -> None:
+        """
+        Pass a message received for this car to the car's event queue.
+
+        Args:
+        - msg (external_protocol.ExternalClient): The received message.
+        - compression (Compression): Compression of the received payload, Connect message negotiates
+            compression of messages published to the car, which is used once the Connect is accepted.
+        """
+        if self._closed:
+            return
+        if msg.HasField("connect"):
+            compression = self._shared_client.codec.negotiate(compression)
+        else:
+            compression = Compression.NONE
+        self._event_queue.add_event(
+            event_type=EventType.RECEIVED_MESSAGE, data=(msg, time.monotonic(), compression)
+        )
+
+    def close(self) -> None:
+        """
+        Drop all messages received for this car from now on.
+        """
+        self._closed = True
+
+    def broker_disconnected(self) -> None:
+        """
+        Announce that shared client was disconnected from the MQTT broker.
+        """
+        self._event_queue.add_event(event_type=EventType.MQTT_BROKER_DISCONNECTED)
+
+    def publish(self, msg: external_protocol.ExternalServer, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish a message to the car's topic.
+
+        Args:
+        - msg (external_protocol.ExternalServer): The message to publish.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+        self.publish_serialized(msg.SerializeToString(), priority)
+
+    def publish_serialized(self, payload: bytes, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish an already serialized message to the car's topic.
+
+        Args:
+        - payload (bytes): The serialized external_protocol.ExternalServer message.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+        self._shared_client.publish_serialized_to(
+            self._publish_topic, self._shared_client.codec.encode(payload, self._compression), priority
+        )
+
+    def set_device_count(self, device_count: int) -> None:
+        """
+        Announce number of connected devices of the car to the shared client.
+
+        Args:
+        - device_count (int): Number of devices of the car.
+        """
+        self._shared_client.set_car_device_count(self._car_name, device_count)
+
+    @property
+    def is_connected(self) -> bool:
+        """
+        Check if the shared client is connected to the broker.
+        """
+        return self._shared_client.is_connected
@@ -0,0 +1,171 @@
+import logging
+import threading
+import time
+from dataclasses import dataclass
+
+from external_server import constants
+from external_server.codec import create_payload_codec
+from external_server.config import Config, ModuleConfig
+from external_server.event_queue import EventQueue
+from external_server.exceptions import ModuleInitError
+from external_server.external_server import ExternalServer
+from external_server.metrics import MetricsRegistry
+from external_server.mqtt_client import MultiCarMqttClient, CarMqttClient
+from external_server.utils import check_file_exists
+
+
+@dataclass
+class _Car:
+    event_queue: EventQueue
+    mqtt_client: CarMqttClient
+    thread: threading.Thread | None = None
+    server: ExternalServer | None = None
+
+
+class MultiCarExternalServer:
+    """External server handling all cars of one company
+
+    All cars share one connection to MQTT broker subscribed to company/+/module_gateway
+    topic. When the first message from a car is received, ExternalServer with its own
+    session state (session id, checkers, connected devices, command threads and module
+    contexts) is created for the car and run in its own thread. Module shared libraries
+    are loaded only once and shared by all cars. Number of handled cars can be limited
+    by multi_car_max_cars and multi_car_allowed_cars, a car is removed when its server stops.
+    """
+
+    def __init__(self, config: Config) -> None:
+        self._logger = logging.getLogger(self.__class__.__name__)
+
+        self._config = config
+        self._mqtt_client = MultiCarMqttClient(
+            self._config.company_name,
+            self._add_car,
+            max_queued_messages=self._config.mqtt_max_queued_messages,
+            max_inflight_messages=self._config.mqtt_max_inflight_messages,
+            adaptive_queue=self._config.mqtt_adaptive_queue,
+            codec=create_payload_codec(self._config),
+        )
+        self._cars: dict[str, _Car] = dict()
+        self._cars_lock = threading.Lock()
+        # Cars whose refusal was already logged
+        self._refused_cars: set[str] = set()
+        self._stopped = threading.Event()
+
+    def set_tls(self, ca_certs: str, certfile: str, keyfile: str) -> None:
+        "Set tls security to mqtt client"
+        if not check_file_exists(ca_certs):
+            raise FileNotFoundError(ca_certs)
+        if not check_file_exists(certfile):
+            raise FileNotFoundError(certfile)
+        if not check_file_exists(keyfile):
+            raise FileNotFoundError(keyfile)
+        self._mqtt_client.set_tls(ca_certs, certfile, keyfile)
+
+    def start(self) -> None:
+        self._mqtt_client.init()
+        self._mqtt_client.register_metrics()
+        MetricsRegistry().readiness_check("mqtt", lambda: self._mqtt_client.is_connected)
+        while not self._stopped.is_set():
+            try:
+                self._mqtt_client.connect(self._config.mqtt_address, self._config.mqtt_port)
+                break
+            except OSError:
+                self._logger.error(
+                    f"Unable to connect to MQTT broker on {self._config.mqtt_address}:{self._config.mqtt_port}, trying again"
+                )
+                time.sleep(self._config.sleep_duration_after_connection_refused)
+
+        # Client reconnects automatically, cars are notified about disconnection by the client
+        self._mqtt_client.start()
+        self._stopped.wait()
+
+    def _add_car(self, car_name: str) -> CarMqttClient | None:
+        with self._cars_lock:
+            if self._stopped.is_set():
+                return None
+            if not self._car_allowed(car_name):
+                return None
+            self._logger.info(f"Received first message from car {car_name}, creating server for the car")
+            event_queue = EventQueue()
+            car = _Car(event_queue, CarMqttClient(self._mqtt_client, self._config.company_name, car_name, event_queue))
+            car.thread = threading.Thread(target=self._run_car, args=(car_name, car), daemon=True)
+            self._cars[car_name] = car
+            car.thread.start()
+            return car.mqtt_client
+
+    def _car_allowed(self, car_name: str) -> bool:
+        """Checks car against multi_car_allowed_cars and multi_car_max_cars, called with _cars_lock held."""
+        if self._config.multi_car_allowed_cars is not None and car_name not in self._config.multi_car_allowed_cars:
+            reason = "the car is not in multi_car_allowed_cars"
+        elif self._config.multi_car_max_cars and len(self._cars) >= self._config.multi_car_max_cars:
+            reason = f"{self._config.multi_car_max_cars} cars are already handled"
+        else:
+            self._refused_cars.discard(car_name)
+            return True
+        if car_name not in self._refused_cars:
+            self._logger.warning(f"Received message from car {car_name}, ignoring it, because {reason}")
+            if len(self._refused_cars) >= constants.MAX_REFUSED_CARS_LOGGED:
+                self._refused_cars.clear()
+            self._refused_cars.add(car_name)
+        return False
+
+    def reload_modules(self, modules: dict[str, ModuleConfig]) -> None:
+        """Requests reload of modules of all cars, servers of cars added later use given modules."""
+        with self._cars_lock:
+            self._config = self._config.model_copy(update={"modules": modules})
+            servers = [car.server for car in self._cars.values() if car.server is not None]
+        for server in servers:
+            server.reload_modules(modules)
+
+    def _run_car(self, car_name: str, car: _Car) -> None:
+        try:
+            self._serve_car(car_name, car)
+        finally:
+            car.mqtt_client.close()
+            with self._cars_lock:
+                if self._cars.get(car_name) is car:
+                    del self._cars[car_name]
+            self._mqtt_client.remove_car(car_name, car.mqtt_client)
+            if not self._stopped.is_set():
+                self._logger.info(f"Server of car {car_name} stopped, car was removed")
+
+    def _serve_car(self, car_name: str, car: _Car) -> None:
+        config = self._config
+        try:
+            server = ExternalServer(config, car_name, car.mqtt_client, car.event_queue)
+        except Exception as e:
+            self._logger.error(f"Server for car {car_name} could not be created: {e}")
+            return
+        try:
+            server.wait_for_modules()
+        except ModuleInitError as e:
+            self._logger.error(f"Modules of car {car_name} could not be initialized: {e}")
+            server.stop()
+            return
+
+        with self._cars_lock:
+            car.server = server
+            stopped = self._stopped.is_set()
+            # Modules were reloaded while the server was being created
+            if self._config is not config:
+                server.reload_modules(self._config.modules)
+        if not stopped:
+            server.start()
+        server.stop()
+
+    def stop(self) -> None:
+        with self._cars_lock:
+            self._stopped.set()
+            cars = list(self._cars.values())
+
+        for car in cars:
+            if car.server is not None:
+                car.server.request_stop()
+            car.mqtt_client.broker_disconnected()
+        for car in cars:
+            car.thread.join()
+
+        self._mqtt_client.stop()
+        self._mqtt_client.remove_metrics()
+        MetricsRegistry().remove_readiness_check("mqtt")
+        self._logger.info("Server stopped by keyboard interrupt")
@@ -0,0 +1,141 @@
+import sys
+from dataclasses import dataclass
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import InternalProtocol_pb2 as internal_protocol
+from external_server.device_registry import DeviceRegistry
+from external_server.metrics import Counter, MetricsRegistry
+
+
+@dataclass(slots=True)
+class StatusFilterSettings:
+    deduplicate: bool = False
+    min_interval: float = 0
+
+
+@dataclass(slots=True)
+class _DeviceState:
+    # Data of the newest status, which was forwarded or is held
+    data: bytes
+    # Monotonic time of the last forwarding
+    forwarded_at: float
+    # Newest status waiting for min_interval to elapse
+    held: tuple[internal_protocol.Device, bytes] | None = None
+
+
+class StatusFilter:
+    """Skips RUNNING statuses, which do not bring a new state of the device to the module
+
+    With deduplicate, status with the same data as the newest status of the device is not
+    forwarded. With min_interval, status received sooner than min_interval after the last
+    forwarded status of the device is held instead of forwarded. Newer status replaces the held
+    one and the held status is forwarded when the interval elapses (see take_due), so the module
+    always ends up with the newest state of every device.
+
+    Args:
+    - settings (dict[int, StatusFilterSettings]): Filter settings by module number, statuses of
+        other modules are always forwarded.
+    - car_name (str): Name of the car, used in metrics.
+    """
+
+    def __init__(self, settings: dict[int, StatusFilterSettings], car_name: str = "") -> None:
+        self._car_name = car_name
+        self._settings: dict[int, StatusFilterSettings] = dict()
+        self._devices: dict[tuple[int, int, str], _DeviceState] = dict()
+        # Keys of devices with held status
+        self._held: set[tuple[int, int, str]] = set()
+        self._duplicates: dict[int, Counter] = dict()
+        self._throttled: dict[int, Counter] = dict()
+        for module, module_settings in settings.items():
+            self.set_module(module, module_settings)
+
+    def set_module(self, module: int, settings: StatusFilterSettings | None) -> None:
+        """Replaces filter settings of the module, state of its devices is discarded.
+
+        Statuses of the module are not filtered if settings is None or filters nothing.
+        """
+        for key in [key for key in self._devices if key[0] == module]:
+            del self._devices[key]
+            self._held.discard(key)
+        if settings is None or not (settings.deduplicate or settings.min_interval > 0):
+            self._settings.pop(module, None)
+            return
+        self._settings[module] = settings
+        registry = MetricsRegistry()
+        self._duplicates[module] = registry.counter(
+            "external_server_filtered_statuses_total",
+            "Number of statuses not forwarded to the module by status filter",
+            car=self._car_name,
+            module=str(module),
+            reason="duplicate",
+        )
+        self._throttled[module] = registry.counter(
+            "external_server_filtered_statuses_total",
+            "Number of statuses not forwarded to the module by status filter",
+            car=self._car_name,
+            module=str(module),
+            reason="throttled",
+        )
+
+    @property
+    def enabled(self) -> bool:
+        return bool(self._settings)
+
+    def forward(self, device: internal_protocol.Device, data: bytes, now: float) -> bool:
+        """Returns True if the status of connected device is to be forwarded now, else the status is skipped or held."""
+        settings = self._settings.get(device.module)
+        if settings is None:
+            return True
+        key = DeviceRegistry.key(device)
+        state = self._devices.get(key)
+        if state is None:
+            self._devices[key] = _DeviceState(data, now)
+            return True
+        if settings.deduplicate and data == state.data:
+            self._duplicates[device.module].inc()
+            return False
+        state.data = data
+        if now - state.forwarded_at < settings.min_interval:
+            if state.held is not None:
+                self._throttled[device.module].inc()
+            state.held = (device, data)
+            self._held.add(key)
+            return False
+        # Forwarded status is newer than the held one
+        if state.held is not None:
+            self._throttled[device.module].inc()
+            state.held = None
+            self._held.discard(key)
+        state.forwarded_at = now
+        return True
+
+    def next_due(self) -> float | None:
+        """Returns monotonic time at which the first held status is due, None if no status is held."""
+        if not self._held:
+            return None
+        return min(
+            self._devices[key].forwarded_at + self._settings[key[0]].min_interval for key in self._held
+        )
+
+    def take_due(self, now: float) -> list[tuple[internal_protocol.Device, bytes]]:
+        """Returns held statuses, which interval has elapsed, in no particular order; they are considered forwarded."""
+        due = []
+        for key in list(self._held):
+            state = self._devices[key]
+            if now - state.forwarded_at >= self._settings[key[0]].min_interval:
+                due.append(state.held)
+                state.held = None
+                state.forwarded_at = now
+                self._held.discard(key)
+        return due
+
+    def remove(self, device: internal_protocol.Device) -> None:
+        """Forgets the device, its held status is discarded."""
+        key = DeviceRegistry.key(device)
+        self._devices.pop(key, None)
+        self._held.discard(key)
+
+    def clear(self) -> None:
+        self._devices.clear()
+        self._held.clear()
@@ -1,5 +1,5 @@
 import ctypes as ct
-from enum import IntEnum
+from enum import Enum, IntEnum
 from dataclasses import dataclass
 
 
@@ -9,6 +9,39 @@ class TimeoutType(IntEnum):
     COMMAND_TIMEOUT = 2
 
 
+class Backpressure(str, Enum):
+    """Handling of status batches forwarded to a module, which dispatch queue is full"""
+
+    BLOCK = "block"  # Main loop waits until the module takes a batch from the queue
+    DROP_OLDEST = "drop_oldest"  # Oldest queued status batch of the module is discarded
+    DISCONNECT = "disconnect"  # All devices of the module are disconnected
+
+
+class ThreadSafety(str, Enum):
+    """Calls of module API functions, which may be made concurrently
+
+    Order of members matches values returned by optional get_thread_safety API function.
+    """
+
+    SERIALIZED = "serialized"  # No calls are concurrent
+    SPLIT = "split"  # Status path calls are concurrent with command path calls (pop_command)
+    CONCURRENT = "concurrent"  # All calls except init and destroy may be concurrent
+
+
+class EventPriority(str, Enum):
+    """Class of events in the main loop event queue and of published messages"""
+
+    HIGH = "high"  # Taken from event queue before normal events, never dropped by full outgoing queue
+    NORMAL = "normal"
+
+
+class TransportType(str, Enum):
+    """Connection of External server to module gateway"""
+
+    MQTT = "mqtt"  # Through MQTT broker
+    UNIX_SOCKET = "unix_socket"  # Module gateway on the same host connects to Unix domain socket of External server
+
+
 # Enum taken from general_error_codes.h in Fleet protocol,
 # must be kept updated with the current version of the Fleet protocol
 
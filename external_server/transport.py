@@ -0,0 +1,154 @@
+import sys
+from abc import ABC, abstractmethod
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+from external_server.codec import Compression
+from external_server.event_queue import EventQueue, EventType
+from external_server.structures import EventPriority
+
+
+class Transport(ABC):
+    """
+    Connection of ExternalServer to the module gateway of one car.
+
+    Received messages are added to the event queue as RECEIVED_MESSAGE events with the message,
+    monotonic time of its reception and compression negotiated by it, loss of the connection
+    as MQTT_BROKER_DISCONNECTED event. Only Connect message negotiates compression, it is used
+    for published messages once ExternalServer accepts the Connect by accept_compression.
+    Messages published while the module gateway can not receive them are dropped.
+
+    Args:
+    - event_queue (EventQueue): The queue for events of the car.
+    """
+
+    def __init__(self, event_queue: EventQueue) -> None:
+        self._event_queue = event_queue
+        self._last_received_at = 0.0
+        self._last_received_compression = Compression.NONE
+        # Compression negotiated by the last accepted Connect message
+        self._compression = Compression.NONE
+
+    @abstractmethod
+    def init(self) -> None:
+        """
+        Prepare the transport, called once before the first connect.
+        """
+
+    def set_tls(self, ca_certs: str, certfile: str, keyfile: str) -> None:
+        """
+        Set the TLS configuration of the connection.
+
+        Args:
+        - ca_certs (str): The path to the CA certificates file.
+        - certfile (str): The path to the client certificate file.
+        - keyfile (str): The path to the client private key file.
+        """
+        raise NotImplementedError(f"{self.__class__.__name__} does not support TLS")
+
+    @abstractmethod
+    def connect(self, ip_address: str, port: int) -> None:
+        """
+        Establish the connection.
+
+        Args:
+        - ip_address (str): The address from config, transports not connecting over network ignore it.
+        - port (int): The port from config, transports not connecting over network ignore it.
+
+        Raises:
+        - ConnectionRefusedError: If the connection can not be established.
+        """
+
+    @abstractmethod
+    def start(self) -> None:
+        """
+        Start receiving messages.
+        """
+
+    @abstractmethod
+    def stop(self) -> None:
+        """
+        Stop receiving messages and close the connection, connect can be called again.
+        """
+
+    @abstractmethod
+    def publish(self, msg: external_protocol.ExternalServer, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish a message to the module gateway.
+
+        Args:
+        - msg (external_protocol.ExternalServer): The message to publish.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+
+    @abstractmethod
+    def publish_serialized(self, payload: bytes, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish an already serialized message to the module gateway.
+
+        Args:
+        - payload (bytes): The serialized external_protocol.ExternalServer message.
+        - priority (EventPriority): HIGH message is not dropped when outgoing queue is full.
+        """
+
+    def set_device_count(self, device_count: int) -> None:
+        """
+        Announce number of connected devices, transports may resize their queues by it.
+
+        Args:
+        - device_count (int): Number of devices, which are communicating through this transport.
+        """
+
+    def register_metrics(self, **labels: str) -> None:
+        """
+        Register metrics of the transport to MetricsRegistry.
+
+        Args:
+        - labels: Labels of the registered metrics.
+        """
+
+    def remove_metrics(self) -> None:
+        """
+        Remove metrics registered by register_metrics from MetricsRegistry.
+        """
+
+    def get(self, timeout: int | None = None) -> external_protocol.ExternalClient | bool | None:
+        """Returns received message
+        Messages are taken from the event queue, other events than received messages and
+        broker disconnection are dropped, so it should be used only outside of main loop.
+        Parameters
+        ----------
+        timeout:int
+            Timeout to wait for received message. If timeout is None, function blocks
+                until message is available.
+        Returns False if broker disconnected, None if no message was received in timeout.
+        """
+        event = self._event_queue.get_received_message(timeout)
+        if event is None:
+            return None
+        if event.event == EventType.MQTT_BROKER_DISCONNECTED:
+            return False
+        msg, self._last_received_at, self._last_received_compression = event.data
+        return msg
+
+    def accept_compression(self) -> None:
+        """
+        Compress messages published from now on by compression negotiated by the Connect message
+        last returned by get, called when ExternalServer accepts the Connect.
+        """
+        self._compression = self._last_received_compression
+
+    @property
+    def last_received_at(self) -> float:
+        """
+        Monotonic time at which the message last returned by get was received.
+        """
+        return self._last_received_at
+
+    @property
+    @abstractmethod
+    def is_connected(self) -> bool:
+        """
+        Check if the connection is established.
+        """
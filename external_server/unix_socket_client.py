@@ -0,0 +1,289 @@
+import logging
+import selectors
+import socket
+import stat
+import struct
+import sys
+import threading
+import time
+from pathlib import Path
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+from external_server.codec import Compression, PayloadCodec
+from external_server.event_queue import EventQueue, EventType
+from external_server.metrics import MetricsRegistry
+from external_server.structures import EventPriority
+from external_server.transport import Transport
+import external_server.constants as constants
+
+
+# Every message is prefixed by its length
+_LENGTH = struct.Struct("<I")
+_RECEIVE_SIZE = 64 * 1024
+
+
+class UnixSocketClient(Transport):
+    """
+    Transport to module gateway running on the same host, without MQTT broker.
+
+    External server listens on a Unix domain stream socket, to which the module gateway connects.
+    Messages in both directions are framed by 4 byte little endian length followed by the payload,
+    payloads are the same as payloads of MQTT messages. One module gateway is connected at a time,
+    a new connection replaces the previous one. Messages published while no module gateway is
+    connected are dropped, same as messages published to MQTT broker without subscriber.
+
+    Messages are received by a thread started by start. Publishing writes the message to the
+    socket directly, there is no outgoing queue; if the module gateway does not read for
+    UNIX_SOCKET_SEND_TIMEOUT, its connection is closed.
+
+    Args:
+    - path (Path): Path of the socket, existing socket at the path is replaced.
+    - event_queue (EventQueue): The queue for events of the car.
+    - codec (PayloadCodec | None): Codec of published and received payloads, payloads are never
+        compressed if not given.
+    """
+
+    def __init__(self, path: Path, event_queue: EventQueue, codec: PayloadCodec | None = None) -> None:
+        super().__init__(event_queue)
+        self._logger = logging.getLogger(self.__class__.__name__)
+        self._path = path
+        self._codec = codec if codec is not None else PayloadCodec()
+        self._listener: socket.socket | None = None
+        self._connection: socket.socket | None = None
+        # Guards the connection, so that whole messages are written and the connection is not replaced while writing
+        self._send_lock = threading.Lock()
+        self._received = bytearray()
+        self._selector: selectors.BaseSelector | None = None
+        # Written by stop to wake up the receiving thread
+        self._wakeup: tuple[socket.socket, socket.socket] | None = None
+        self._thread: threading.Thread | None = None
+        self._is_connected = False
+        self._dropped_messages = 0
+        self._metrics_labels: dict[str, str] | None = None
+
+    def init(self) -> None:
+        """
+        Nothing to initialize, the socket is created by connect.
+        """
+        pass
+
+    def set_tls(self, ca_certs: str, certfile: str, keyfile: str) -> None:
+        """
+        TLS is not used, access to the socket is controlled by permissions of the socket file.
+        """
+        self._logger.warning("TLS is not used by Unix socket transport")
+
+    def connect(self, _ip_address: str, _port: int) -> None:
+        """
+        Create the socket and listen for connection of module gateway.
+
+        Raises:
+        - ConnectionRefusedError: If the socket can not be created.
+        """
+        listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            self._remove_socket_file()
+            listener.bind(str(self._path))
+            listener.listen(1)
+        except OSError as e:
+            listener.close()
+            raise ConnectionRefusedError(str(e)) from e
+        self._listener = listener
+        self._is_connected = True
+        self._logger.info(f"Listening for module gateway on {self._path}")
+
+    def _remove_socket_file(self) -> None:
+        """Removes socket left at the path, other files are kept and binding fails."""
+        try:
+            if stat.S_ISSOCK(self._path.lstat().st_mode):
+                self._path.unlink()
+        except FileNotFoundError:
+            pass
+
+    def start(self) -> None:
+        """
+        Start the thread receiving messages.
+        """
+        if self._listener is None or self._thread is not None:
+            return
+        self._selector = selectors.DefaultSelector()
+        self._wakeup = socket.socketpair()
+        self._selector.register(self._wakeup[0], selectors.EVENT_READ)
+        self._selector.register(self._listener, selectors.EVENT_READ)
+        self._thread = threading.Thread(target=self._receive_loop, name="UnixSocketClient", daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        """
+        Stop receiving, close connection of module gateway and remove the socket.
+        """
+        if self._thread is not None:
+            self._wakeup[1].send(b"\0")
+            self._thread.join()
+            self._thread = None
+        self._close_connection()
+        if self._selector is not None:
+            self._selector.close()
+            self._selector = None
+        if self._wakeup is not None:
+            for wakeup_socket in self._wakeup:
+                wakeup_socket.close()
+            self._wakeup = None
+        if self._listener is not None:
+            self._listener.close()
+            self._listener = None
+            self._remove_socket_file()
+        self._is_connected = False
+
+    def _receive_loop(self) -> None:
+        while True:
+            for key, _events in self._selector.select():
+                if key.fileobj is self._wakeup[0]:
+                    return
+                if key.fileobj is self._listener:
+                    self._accept()
+                elif key.fileobj is self._connection:
+                    # Events of a connection replaced in this iteration are skipped
+                    self._receive()
+
+    def _accept(self) -> None:
+        try:
+            connection, _address = self._listener.accept()
+        except OSError as e:
+            self._logger.warning(f"Connection of module gateway was not accepted: {e}")
+            return
+        if self._connection is not None:
+            self._logger.info("Module gateway connected again, previous connection is closed")
+            self._close_connection()
+        connection.settimeout(constants.UNIX_SOCKET_SEND_TIMEOUT)
+        with self._send_lock:
+            self._connection = connection
+        self._selector.register(connection, selectors.EVENT_READ)
+        self._logger.info("Module gateway connected")
+
+    def _receive(self) -> None:
+        try:
+            data = self._connection.recv(_RECEIVE_SIZE)
+        except OSError as e:
+            self._logger.warning(f"Receiving from module gateway failed: {e}")
+            data = b""
+        if not data:
+            self._logger.info("Module gateway disconnected")
+            self._close_connection()
+            return
+        received_at = time.monotonic()
+        self._received += data
+        offset = 0
+        while len(self._received) - offset >= _LENGTH.size:
+            (length,) = _LENGTH.unpack_from(self._received, offset)
+            if length > constants.UNIX_SOCKET_MAX_MESSAGE_SIZE:
+                self._logger.error(f"Module gateway sent message of {length} bytes, connection is closed")
+                self._close_connection()
+                return
+            end = offset + _LENGTH.size + length
+            if end > len(self._received):
+                break
+            self._handle_payload(bytes(self._received[offset + _LENGTH.size : end]), received_at)
+            offset = end
+        del self._received[:offset]
+
+    def _handle_payload(self, payload: bytes, received_at: float) -> None:
+        try:
+            payload, compression = self._codec.decode(payload)
+            msg = external_protocol.ExternalClient().FromString(payload)
+        except Exception as e:
+            # PayloadDecodeError or invalid protobuf message, raising would end the receiving thread
+            self._logger.warning(f"Message received on {self._path} was dropped: {e}")
+            return
+        if msg.HasField("connect"):
+            compression = self._codec.negotiate(compression)
+        else:
+            compression = Compression.NONE
+        self._event_queue.add_event(event_type=EventType.RECEIVED_MESSAGE, data=(msg, received_at, compression))
+
+    def _close_connection(self) -> None:
+        """Closes connection of module gateway, called by the receiving thread or when it is stopped."""
+        with self._send_lock:
+            connection = self._connection
+            self._connection = None
+        if connection is None:
+            return
+        if self._selector is not None:
+            self._selector.unregister(connection)
+        connection.close()
+        self._received.clear()
+
+    def publish(self, msg: external_protocol.ExternalServer, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish a message to the module gateway.
+
+        Args:
+        - msg (external_protocol.ExternalServer): The message to publish.
+        - priority (EventPriority): Not used, messages are not queued.
+        """
+        self.publish_serialized(msg.SerializeToString(), priority)
+
+    def publish_serialized(self, payload: bytes, priority: EventPriority = EventPriority.NORMAL) -> None:
+        """
+        Publish an already serialized message to the module gateway.
+
+        Args:
+        - payload (bytes): The serialized external_protocol.ExternalServer message.
+        - priority (EventPriority): Not used, messages are not queued.
+        """
+        payload = self._codec.encode(payload, self._compression)
+        with self._send_lock:
+            if self._connection is None:
+                self._dropped_messages += 1
+                return
+            try:
+                self._connection.sendall(_LENGTH.pack(len(payload)) + payload)
+                return
+            except OSError as e:
+                self._dropped_messages += 1
+                # Part of the message may have been written, the receiving thread closes the connection
+                self._logger.warning(f"Sending to module gateway failed, connection is closed: {e}")
+                try:
+                    self._connection.shutdown(socket.SHUT_RDWR)
+                except OSError:
+                    pass
+
+    @property
+    def dropped_messages(self) -> int:
+        """
+        Number of messages dropped because no module gateway was connected or sending failed.
+        """
+        return self._dropped_messages
+
+    def register_metrics(self, **labels: str) -> None:
+        """
+        Register counter of dropped messages to MetricsRegistry.
+
+        Args:
+        - labels: Labels of the registered metrics.
+        """
+        MetricsRegistry().function_counter(
+            "external_server_unix_socket_dropped_messages_total",
+            "Number of messages dropped because no module gateway was connected to Unix socket or sending failed",
+            lambda: self.dropped_messages,
+            **labels,
+        )
+        self._metrics_labels = labels
+
+    def remove_metrics(self) -> None:
+        """
+        Remove metrics registered by register_metrics from MetricsRegistry.
+        """
+        if self._metrics_labels is None:
+            return
+        MetricsRegistry().remove_gauge("external_server_unix_socket_dropped_messages_total", **self._metrics_labels)
+        self._metrics_labels = None
+
+    @property
+    def is_connected(self) -> bool:
+        """
+        Check if the socket is listening, module gateway may not be connected.
+        """
+        return self._is_connected
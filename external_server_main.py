@@ -1,15 +1,16 @@
 #!/usr/bin/env python3
 import logging
-import logging.handlers
-import json
+import signal
 import sys
-
-from rich.logging import RichHandler
+import threading
 
 from external_server.utils import argparse_init
 from external_server.external_server import ExternalServer
+from external_server.multi_car_external_server import MultiCarExternalServer
 from external_server.config import Config, load_config, InvalidConfigError
-from external_server import constants
+from external_server.exceptions import ModuleInitError
+from external_server.metrics import MetricsServer
+from external_server.logs import setup_logging
 
 
 def main() -> None:
@@ -21,31 +22,21 @@ def main() -> None:
         print(f"Invalid config: {exc}")
         sys.exit(1)
 
-    if (config.log_files_to_keep):
-            file_handler = logging.handlers.RotatingFileHandler(
-                filename=str(config.log_files_directory) + "/" + constants.LOG_FILE_NAME,
-                maxBytes=config.log_file_max_size_bytes,
-                backupCount=config.log_files_to_keep - 1
-            )
-            file_handler.setFormatter(logging.Formatter(constants.LOG_FORMAT))
-            logging.basicConfig(
-                level=logging.INFO,
-                format="%(name)s: %(message)s",
-                datefmt="[%X]",
-                handlers=[RichHandler(), file_handler],
-            )
-    else:
-        logging.basicConfig(
-        level=logging.INFO,
-        format="%(name)s: %(message)s",
-        datefmt="[%X]",
-        handlers=[RichHandler()],
-    )
-        
+    setup_logging(config)
+
     logger = logging.getLogger("Main")
     logger.info(f"Loaded config:\n{config.get_config_dump_string()}")
 
-    server = ExternalServer(config)
+    # Metrics server starts first, so that health and readiness are served during initialization
+    metrics_server = None
+    if config.metrics_port is not None:
+        metrics_server = MetricsServer(config.metrics_port)
+        metrics_server.start()
+
+    if config.multi_car:
+        server = MultiCarExternalServer(config)
+    else:
+        server = ExternalServer(config)
     if args.tls:
         if args.ca is None or args.cert is None or args.key is None:
             logger.error(
@@ -54,10 +45,39 @@ def main() -> None:
             sys.exit(1)
         server.set_tls(args.ca, args.cert, args.key)
 
+    reload_requested = threading.Event()
+
+    def reload_modules() -> None:
+        # Config loaded by the last reload, other changes than of modules are reported only once
+        applied_config = config
+        while True:
+            reload_requested.wait()
+            reload_requested.clear()
+            try:
+                new_config = load_config(args.config)
+            except InvalidConfigError as exc:
+                logger.error(f"Modules have not been reloaded, invalid config: {exc}")
+                continue
+            if new_config.model_copy(update={"modules": applied_config.modules}) != applied_config:
+                logger.warning("Only modules are reloaded, restart the server to apply other config changes")
+            logger.info("Reloading modules")
+            server.reload_modules(new_config.modules)
+            applied_config = new_config
+
+    threading.Thread(target=reload_modules, name="ModuleReload", daemon=True).start()
+    # Handler interrupts the main thread, which may hold locks used by reload, so it only wakes the reload thread
+    signal.signal(signal.SIGHUP, lambda _signum, _frame: reload_requested.set())
+
     try:
         server.start()
     except KeyboardInterrupt:
         server.stop()
+    except ModuleInitError:
+        server.stop()
+        sys.exit(1)
+    finally:
+        if metrics_server is not None:
+            metrics_server.stop()
 
 
 if __name__ == "__main__":
@@ -0,0 +1,54 @@
+import pytest
+
+from external_server.codec import Compression, PayloadCodec
+from external_server.exceptions import PayloadDecodeError
+
+
+PAYLOAD = b"\x12" + b"route stop position telemetry " * 40
+DICTIONARY = b"route stop position telemetry " * 4
+
+
+class TestPayloadCodec:
+    def test_payload_is_compressed_and_decompressed(self):
+        codec = PayloadCodec(enabled=True)
+
+        encoded = codec.encode(PAYLOAD, Compression.ZLIB)
+        assert encoded[:2] == bytes((PayloadCodec.MARKER, Compression.ZLIB))
+        assert len(encoded) < len(PAYLOAD)
+        assert codec.decode(encoded) == (PAYLOAD, Compression.ZLIB)
+
+    def test_dictionary_is_used_for_both_directions(self):
+        codec = PayloadCodec(enabled=True, dictionary=DICTIONARY)
+
+        encoded = codec.encode(PAYLOAD, Compression.ZLIB)
+        assert len(encoded) < len(PayloadCodec(enabled=True).encode(PAYLOAD, Compression.ZLIB))
+        assert codec.decode(encoded) == (PAYLOAD, Compression.ZLIB)
+        with pytest.raises(PayloadDecodeError):
+            PayloadCodec().decode(encoded)
+
+    def test_plain_and_short_payloads_are_not_changed(self):
+        codec = PayloadCodec(enabled=True, threshold=len(PAYLOAD) + 1)
+
+        assert codec.encode(PAYLOAD, Compression.ZLIB) == PAYLOAD
+        assert codec.encode(PAYLOAD, Compression.NONE) == PAYLOAD
+        assert codec.decode(PAYLOAD) == (PAYLOAD, Compression.NONE)
+        assert codec.decode(b"") == (b"", Compression.NONE)
+
+    def test_unknown_compression_can_not_be_decoded(self):
+        with pytest.raises(PayloadDecodeError):
+            PayloadCodec().decode(bytes((PayloadCodec.MARKER, 200)) + b"data")
+        with pytest.raises(PayloadDecodeError):
+            PayloadCodec().decode(bytes((PayloadCodec.MARKER, Compression.ZLIB)) + b"not zlib")
+
+    def test_payload_decompressed_over_limit_can_not_be_decoded(self):
+        codec = PayloadCodec(enabled=True)
+        limit_payload = b"\x12" + bytes(PayloadCodec.MAX_DECOMPRESSED_SIZE - 1)
+
+        assert codec.decode(codec.encode(limit_payload, Compression.ZLIB)) == (limit_payload, Compression.ZLIB)
+        with pytest.raises(PayloadDecodeError, match="exceeds"):
+            codec.decode(codec.encode(limit_payload + b"\x00", Compression.ZLIB))
+
+    def test_compression_is_negotiated_only_if_enabled(self):
+        assert PayloadCodec(enabled=True).negotiate(Compression.ZLIB) == Compression.ZLIB
+        assert PayloadCodec(enabled=True).negotiate(Compression.NONE) == Compression.NONE
+        assert PayloadCodec(enabled=False).negotiate(Compression.ZLIB) == Compression.NONE
@@ -0,0 +1,120 @@
+import sys
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+import InternalProtocol_pb2 as internal_protocol
+from external_server.command_journal import CommandJournal
+
+
+def _command(counter: int, data: bytes = b"data") -> external_protocol.Command:
+    device = internal_protocol.Device(module=1, deviceType=0, deviceRole="role", deviceName="name")
+    return external_protocol.Command(
+        sessionId="session",
+        messageCounter=counter,
+        deviceCommand=internal_protocol.DeviceCommand(device=device, commandData=data),
+    )
+
+
+def _counters(commands: dict[int, external_protocol.Command]) -> list[int]:
+    return [command.messageCounter for command in commands.values()]
+
+
+class TestCommandJournal:
+    def test_not_acknowledged_commands_are_recovered_after_crash(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        assert journal.recovered_commands() == {}
+        journal.start_session()
+        for counter in range(4):
+            journal.append(_command(counter, bytes([counter])))
+        journal.ack(1)
+        journal.ack(3)
+        # Crashed process does not end its session
+        recovered = CommandJournal(tmp_path, 4096).recovered_commands()
+        assert _counters(recovered) == [0, 2]
+        assert recovered[1].deviceCommand.commandData == bytes([2])
+
+    def test_ended_session_is_not_recovered(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        journal.start_session()
+        journal.append(_command(0))
+        journal.end_session()
+        assert CommandJournal(tmp_path, 4096).recovered_commands() == {}
+
+    def test_segment_is_reused_once_all_commands_are_acknowledged(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        journal.start_session()
+        for counter in range(1000):
+            journal.append(_command(counter))
+            journal.ack(counter)
+        journal.append(_command(1000))
+        assert [path.stat().st_size for path in tmp_path.iterdir()] == [4096]
+        assert _counters(CommandJournal(tmp_path, 4096).recovered_commands()) == [1000]
+
+    def test_full_segment_is_compacted_and_grown(self, tmp_path):
+        journal = CommandJournal(tmp_path, 256)
+        journal.start_session()
+        for counter in range(100):
+            journal.append(_command(counter, b"x" * 50))
+            if counter % 10:
+                journal.ack(counter)
+        assert list(tmp_path.iterdir())[0].stat().st_size > 256
+        assert _counters(CommandJournal(tmp_path, 256).recovered_commands()) == list(range(0, 100, 10))
+
+    def test_cut_record_is_ignored(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        journal.start_session()
+        journal.append(_command(0))
+        journal.append(_command(1))
+        journal.close()
+        segment = list(tmp_path.iterdir())[0]
+        data = bytearray(segment.read_bytes())
+        # Payload of the second record is written, but not its kind
+        first_length = int.from_bytes(data[8:12], "little")
+        data[12 + first_length] = 0
+        segment.write_bytes(data)
+        assert _counters(CommandJournal(tmp_path, 4096).recovered_commands()) == [0]
+
+    def test_recovered_segments_are_deleted_once_carried(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        journal.start_session()
+        journal.append(_command(0))
+        recovering = CommandJournal(tmp_path, 4096)
+        recovering.start_session()
+        assert len(list(tmp_path.iterdir())) == 1
+        assert _counters(CommandJournal(tmp_path, 4096).recovered_commands()) == [0]
+
+    def test_replayed_command_is_kept_until_acknowledged(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        journal.start_session()
+        journal.append(_command(7))
+        recovering = CommandJournal(tmp_path, 4096)
+        recovering.start_session()
+        recovering.replayed(0, 0)
+        # Failed session does not lose the replayed command
+        recovering.end_session()
+        assert _counters(CommandJournal(tmp_path, 4096).recovered_commands()) == [7]
+
+        recovering.start_session()
+        recovering.replayed(0, 3)
+        recovering.append(_command(4))
+        recovering.ack(3)
+        assert recovering.recovered_commands() == {}
+        assert _counters(CommandJournal(tmp_path, 4096).recovered_commands()) == [4]
+        recovering.end_session()
+        assert list(tmp_path.iterdir()) == []
+
+    def test_not_replayed_command_is_carried_across_sessions(self, tmp_path):
+        journal = CommandJournal(tmp_path, 4096)
+        journal.start_session()
+        journal.append(_command(0))
+        journal.append(_command(1))
+        recovering = CommandJournal(tmp_path, 256)
+        for session in range(20):
+            recovering.start_session()
+            # Collides with recovery id of the carried command, but is a command of the session
+            recovering.append(_command(1, b"x" * 50))
+            recovering.ack(1)
+            recovering.end_session()
+        assert len(list(tmp_path.iterdir())) == 1
+        assert _counters(CommandJournal(tmp_path, 256).recovered_commands()) == [0, 1]
@@ -88,3 +88,97 @@ class TestCommandMessagesChecker:
         time.sleep(self.SLEEP_TIME)
 
         checker.check_time_out()
+
+
+class TestCommandMessagesCheckerDeviceCommandCount:
+    TIMEOUT = 10
+
+    @staticmethod
+    def _command(role: str) -> external_protocol.Command:
+        command = external_protocol.Command()
+        command.deviceCommand.device.module = 1
+        command.deviceCommand.device.deviceType = 0
+        command.deviceCommand.device.deviceRole = role
+        return command
+
+    def test_commands_are_counted_per_device_until_acknowledged(self):
+        checker = CommandMessagesChecker(self.TIMEOUT)
+        checker.add_command(self._command("role_1"), True)
+        checker.add_command(self._command("role_1"), True)
+        checker.add_command(self._command("role_2"), True)
+
+        assert checker.device_command_count(self._command("role_1").deviceCommand.device) == 2
+        checker.pop_commands(0)
+        assert checker.device_command_count(self._command("role_1").deviceCommand.device) == 1
+        assert checker.device_command_count(self._command("role_2").deviceCommand.device) == 1
+
+        checker.reset()
+        assert checker.device_command_count(self._command("role_1").deviceCommand.device) == 0
+
+    def test_disowned_commands_are_not_returned_from_api(self):
+        checker = CommandMessagesChecker(self.TIMEOUT)
+        other_module_command = self._command("role_2")
+        other_module_command.deviceCommand.device.module = 2
+        checker.add_command(self._command("role_1"), True)
+        checker.add_command(other_module_command, True)
+        checker.disown_module_commands(1)
+        checker.add_command(self._command("role_1"), True)
+
+        assert [returned_from_api for _, returned_from_api in checker.pop_commands(0)] == [False]
+        assert checker.device_command_count(self._command("role_1").deviceCommand.device) == 1
+        assert [returned_from_api for _, returned_from_api in checker.pop_commands(1)] == [True]
+        assert [returned_from_api for _, returned_from_api in checker.pop_commands(2)] == [True]
+
+    def test_suspended_timers_are_restarted_on_resume(self):
+        checker = CommandMessagesChecker(self.TIMEOUT)
+        checker.add_command(self._command("role_1"), True)
+        suspended_timer = checker._deadline
+
+        checker.suspend_timers()
+        assert suspended_timer.cancelled
+        checker.resume_timers()
+
+        resumed_timer = checker._deadline
+        assert not resumed_timer.cancelled
+        assert resumed_timer.when >= suspended_timer.when
+        assert len(checker.pop_commands(0)) == 1
+        checker.reset()
+
+
+class TestCommandMessagesCheckerOutOfOrderAcks:
+    TIMEOUT = 10
+
+    @staticmethod
+    def _checker_with_commands(count: int) -> CommandMessagesChecker:
+        checker = CommandMessagesChecker(TestCommandMessagesCheckerOutOfOrderAcks.TIMEOUT)
+        for _ in range(count):
+            checker.add_command(TestCommandMessagesCheckerDeviceCommandCount._command("role_1"), True)
+        return checker
+
+    def test_reversed_acks_pop_all_commands_with_last_ack(self):
+        checker = self._checker_with_commands(5)
+        for counter in range(4, 0, -1):
+            assert checker.pop_commands(counter) == []
+
+        assert len(checker.pop_commands(0)) == 5
+        assert checker._deadline is None
+
+    def test_deadline_moves_to_oldest_not_acknowledged_command(self):
+        checker = self._checker_with_commands(3)
+        first_deadline = checker._deadline
+        checker.pop_commands(1)
+        assert checker._deadline is first_deadline
+
+        assert len(checker.pop_commands(0)) == 2
+        assert first_deadline.cancelled
+        assert checker._deadline is not None and not checker._deadline.cancelled
+        checker.reset()
+
+    def test_unknown_and_repeated_acks_are_ignored(self):
+        checker = self._checker_with_commands(2)
+        assert checker.pop_commands(1) == []
+        assert checker.pop_commands(1) == []
+        assert checker.pop_commands(7) == []
+
+        assert len(checker.pop_commands(0)) == 2
+        assert checker.pop_commands(0) == []
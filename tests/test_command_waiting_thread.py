@@ -0,0 +1,66 @@
+import sys
+from unittest.mock import MagicMock
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import InternalProtocol_pb2 as internal_protocol
+from external_server.command_waiting_thread import CommandWaitingThread
+from external_server.event_queue import EventQueue, EventType
+from external_server.structures import EventPriority
+
+
+def _thread(commands: list[bytes]) -> tuple[CommandWaitingThread, EventQueue]:
+    api_client = MagicMock()
+    api_client.get_module_number.return_value = 1
+    api_client.pop_command.side_effect = [
+        (command, internal_protocol.Device(), len(commands) - i - 1) for i, command in enumerate(commands)
+    ]
+    event_queue = EventQueue()
+    return CommandWaitingThread(api_client, event_queue), event_queue
+
+
+class TestCommandWaitingThread:
+    def test_all_commands_are_drained(self):
+        thread, event_queue = _thread([b"command_1", b"command_2", b"command_3"])
+        thread.connection_established = True
+        thread._save_available_commands()
+
+        commands = thread.pop_commands()
+        assert [command for command, _, _ in commands] == [b"command_1", b"command_2", b"command_3"]
+        assert thread.pop_commands() == []
+        assert event_queue.get(block=False).event == EventType.COMMAND_AVAILABLE
+
+    def test_only_latest_command_is_kept_without_connection(self):
+        thread, event_queue = _thread([b"command_1", b"command_2"])
+        thread._save_available_commands()
+
+        assert thread.pop_command() == (b"command_2", internal_protocol.Device())
+        assert thread.pop_command() is None
+        assert event_queue.qsize() == 0
+
+    def test_commands_are_discarded_when_connection_drops(self):
+        thread, _ = _thread([b"command_1", b"command_2"])
+        thread.connection_established = True
+        thread._save_available_commands()
+        thread.connection_established = False
+
+        assert len(thread._commands) == 0
+        assert thread.pop_commands() == []
+
+    def test_commands_do_not_accumulate_without_connection(self):
+        thread, _ = _thread([f"command_{i}".encode() for i in range(100)])
+        thread._save_available_commands()
+
+        assert len(thread._commands) == 1
+        assert thread.pop_command() == (b"command_99", internal_protocol.Device())
+
+    def test_command_available_event_has_priority_of_thread(self):
+        api_client = MagicMock()
+        api_client.get_module_number.return_value = 1
+        api_client.pop_command.return_value = (b"stop", internal_protocol.Device(), 0)
+        event_queue = EventQueue()
+        thread = CommandWaitingThread(api_client, event_queue, EventPriority.HIGH)
+        thread.connection_established = True
+        thread._save_available_commands()
+
+        assert event_queue.get(block=False).priority == EventPriority.HIGH
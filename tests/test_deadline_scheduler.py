@@ -0,0 +1,60 @@
+import threading
+import time
+
+from external_server.checker.deadline_scheduler import DeadlineScheduler
+
+
+TIMEOUT = 0.2
+SLEEP_TIME = TIMEOUT + 0.1
+
+
+class TestDeadlineScheduler:
+    def test_scheduler_is_shared(self):
+        assert DeadlineScheduler() is DeadlineScheduler()
+
+    def test_callback_is_called_after_delay(self):
+        called = threading.Event()
+        start = time.monotonic()
+        DeadlineScheduler().schedule(TIMEOUT, called.set)
+
+        assert called.wait(SLEEP_TIME + 1)
+        assert time.monotonic() - start >= TIMEOUT
+
+    def test_cancelled_callback_is_not_called(self):
+        called = threading.Event()
+        deadline = DeadlineScheduler().schedule(TIMEOUT, called.set)
+        deadline.cancel()
+
+        time.sleep(SLEEP_TIME)
+        assert deadline.cancelled
+        assert not called.is_set()
+
+    def test_earlier_deadline_is_called_before_later_one(self):
+        order = []
+        done = threading.Event()
+
+        def later():
+            order.append("later")
+            done.set()
+
+        DeadlineScheduler().schedule(TIMEOUT * 2, later)
+        DeadlineScheduler().schedule(TIMEOUT, lambda: order.append("earlier"))
+
+        assert done.wait(SLEEP_TIME * 2 + 1)
+        assert order == ["earlier", "later"]
+
+    def test_many_cancelled_deadlines_are_removed_from_heap(self):
+        scheduler = DeadlineScheduler()
+        deadlines = [scheduler.schedule(60, lambda: None) for _ in range(1000)]
+        for deadline in deadlines:
+            deadline.cancel()
+
+        assert len(scheduler._heap) < 1000
+
+    def test_cancel_after_callback_is_noop(self):
+        called = threading.Event()
+        deadline = DeadlineScheduler().schedule(0, called.set)
+        assert called.wait(1)
+
+        deadline.cancel()
+        assert deadline.cancelled
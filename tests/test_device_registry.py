@@ -0,0 +1,83 @@
+import sys
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import InternalProtocol_pb2 as internal_protocol
+from external_server.device_registry import DeviceRegistry
+
+
+def _device(module: int, device_type: int, role: str, name: str = "name") -> internal_protocol.Device:
+    return internal_protocol.Device(module=module, deviceType=device_type, deviceRole=role, deviceName=name)
+
+
+class TestDeviceRegistry:
+    def test_added_device_is_in_registry(self):
+        registry = DeviceRegistry()
+        assert registry.add(_device(1, 2, "role"))
+
+        assert _device(1, 2, "role") in registry
+        assert _device(1, 2, "other_role") not in registry
+        assert _device(2, 2, "role") not in registry
+        assert len(registry) == 1
+
+    def test_device_is_identified_without_name(self):
+        registry = DeviceRegistry()
+        registry.add(_device(1, 2, "role", "name"))
+
+        assert _device(1, 2, "role", "other_name") in registry
+        assert not registry.add(_device(1, 2, "role", "other_name"))
+        assert len(registry) == 1
+
+    def test_remove_device(self):
+        registry = DeviceRegistry()
+        registry.add(_device(1, 2, "role"))
+
+        assert registry.remove(_device(1, 2, "role"))
+        assert not registry.remove(_device(1, 2, "role"))
+        assert _device(1, 2, "role") not in registry
+        assert len(registry) == 0
+
+    def test_module_device_count(self):
+        registry = DeviceRegistry()
+        registry.add(_device(1, 2, "role_1"))
+        registry.add(_device(1, 2, "role_2"))
+        registry.add(_device(2, 2, "role_1"))
+
+        assert registry.module_device_count(1) == 2
+        assert registry.module_device_count(2) == 1
+        assert registry.module_device_count(3) == 0
+
+        registry.remove(_device(1, 2, "role_1"))
+        registry.remove(_device(2, 2, "role_1"))
+        assert registry.module_device_count(1) == 1
+        assert registry.module_device_count(2) == 0
+
+    def test_copy_is_independent(self):
+        registry = DeviceRegistry()
+        registry.add(_device(1, 2, "role"))
+        copy = registry.copy()
+
+        copy.remove(_device(1, 2, "role"))
+
+        assert _device(1, 2, "role") in registry
+        assert registry.module_device_count(1) == 1
+        assert len(copy) == 0
+
+    def test_iterating_returns_python_devices(self):
+        registry = DeviceRegistry()
+        registry.add(_device(1, 2, "role", "name"))
+
+        devices = list(registry)
+        assert len(devices) == 1
+        assert devices[0].module == 1
+        assert devices[0].device_type == 2
+        assert devices[0].device_role == "role"
+        assert devices[0].device_name == "name"
+
+    def test_clear(self):
+        registry = DeviceRegistry()
+        registry.add(_device(1, 2, "role"))
+        registry.clear()
+
+        assert len(registry) == 0
+        assert registry.module_device_count(1) == 0
@@ -0,0 +1,66 @@
+import queue
+import time
+
+import pytest
+
+from external_server import constants
+from external_server.event_queue import EventQueue, EventType
+from external_server.metrics import MetricsRegistry
+from external_server.structures import EventPriority
+
+
+class TestEventQueue:
+    def test_events_of_same_priority_are_taken_in_order(self):
+        event_queue = EventQueue()
+        for i in range(3):
+            event_queue.add_event(EventType.RECEIVED_MESSAGE, i)
+        assert [event_queue.get(block=False).data for _ in range(3)] == [0, 1, 2]
+
+    def test_high_priority_event_is_taken_first(self):
+        event_queue = EventQueue()
+        event_queue.add_event(EventType.RECEIVED_MESSAGE, "status")
+        event_queue.add_event(EventType.COMMAND_AVAILABLE, 1, EventPriority.HIGH)
+        assert event_queue.get(block=False).data == 1
+        assert event_queue.get(block=False).data == "status"
+
+    def test_normal_events_are_not_starved(self):
+        event_queue = EventQueue()
+        event_queue.add_event(EventType.RECEIVED_MESSAGE, "status")
+        for _ in range(2 * constants.HIGH_PRIORITY_EVENT_BURST):
+            event_queue.add_event(EventType.COMMAND_AVAILABLE, 1, EventPriority.HIGH)
+        taken = [event_queue.get(block=False).data for _ in range(2 * constants.HIGH_PRIORITY_EVENT_BURST + 1)]
+        assert taken.index("status") == constants.HIGH_PRIORITY_EVENT_BURST
+
+    def test_get_raises_empty_after_timeout(self):
+        event_queue = EventQueue()
+        with pytest.raises(queue.Empty):
+            event_queue.get(block=False)
+        start = time.monotonic()
+        with pytest.raises(queue.Empty):
+            event_queue.get(timeout=0.1)
+        assert time.monotonic() - start >= 0.1
+
+    def test_clear_keeps_received_messages(self):
+        # Status received at the end of the connect sequence, while commands were being popped
+        event_queue = EventQueue()
+        event_queue.add_event(EventType.COMMAND_AVAILABLE, 1, EventPriority.HIGH)
+        event_queue.add_event(EventType.RECEIVED_MESSAGE, "status")
+        event_queue.add_event(EventType.TIMEOUT_OCCURRED)
+        event_queue.add_event(EventType.MQTT_BROKER_DISCONNECTED)
+        event_queue.clear(keep=(EventType.RECEIVED_MESSAGE, EventType.MQTT_BROKER_DISCONNECTED))
+        assert event_queue.qsize() == 2
+        assert event_queue.get(block=False).data == "status"
+        assert event_queue.get(block=False).event == EventType.MQTT_BROKER_DISCONNECTED
+
+        event_queue.add_event(EventType.RECEIVED_MESSAGE, "status")
+        event_queue.clear()
+        assert event_queue.qsize() == 0
+
+    def test_queueing_delay_is_recorded_per_priority(self):
+        event_queue = EventQueue()
+        event_queue.register_metrics(car="delay_test")
+        event_queue.add_event(EventType.COMMAND_AVAILABLE, 1, EventPriority.HIGH)
+        event_queue.get(block=False)
+        exposition = MetricsRegistry().render()
+        assert 'external_server_event_queue_delay_seconds_count{car="delay_test",priority="high"} 1' in exposition
+        assert 'external_server_event_queue_delay_seconds_count{car="delay_test",priority="normal"} 0' in exposition
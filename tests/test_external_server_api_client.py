@@ -1,5 +1,10 @@
 # Generated by CodiumAI
-from external_server.external_server_api_client import ExternalServerApiClient
+import ctypes as ct
+import threading
+from unittest.mock import MagicMock
+
+from external_server.external_server_api_client import ExternalServerApiClient, _fastpath
+from external_server.structures import Buffer, DeviceIdentification, ThreadSafety
 
 import pytest
 
@@ -49,3 +54,281 @@ class TestExternalServerApiClient:
         assert result == 0
         result = client.device_disconnected(device)
         assert result == 0
+
+
+class TestExternalServerApiClientBatches:
+    module_config = MagicMock()
+
+    def _client(self, batch_supported: bool) -> ExternalServerApiClient:
+        client = ExternalServerApiClient(self.module_config, "bringauto", "car_1")
+        client._library = MagicMock()
+        client._library.forward_status.return_value = 0
+        client._library.forward_status_batch.return_value = 0
+        client._library.command_ack.return_value = 0
+        client._library.command_ack_batch.return_value = 0
+        client._forward_status_batch_supported = batch_supported
+        client._command_ack_batch_supported = batch_supported
+        return client
+
+    def test_forward_statuses_uses_batch_function_if_supported(self):
+        client = self._client(batch_supported=True)
+        statuses = [(Device(1, 2, "role", "name", 0), b"status_1"), (Device(1, 3, "role", "name", 0), b"status_2")]
+
+        assert client.forward_statuses(statuses) == 0
+        client._library.forward_status_batch.assert_called_once()
+        assert client._library.forward_status_batch.call_args.args[2] == 2
+        client._library.forward_status.assert_not_called()
+
+    def test_forward_statuses_falls_back_to_single_calls(self):
+        client = self._client(batch_supported=False)
+        statuses = [(Device(1, 2, "role", "name", 0), b"status_1"), (Device(1, 3, "role", "name", 0), b"status_2")]
+
+        assert client.forward_statuses(statuses) == 0
+        assert client._library.forward_status.call_count == 2
+
+    def test_forward_statuses_fallback_returns_failed_result(self):
+        client = self._client(batch_supported=False)
+        client._library.forward_status.side_effect = [0, -1, 0]
+        statuses = [(Device(1, 2, "role", f"name_{i}", 0), b"status") for i in range(3)]
+
+        assert client.forward_statuses(statuses) == -1
+
+    def test_command_acks_uses_batch_function_if_supported(self):
+        client = self._client(batch_supported=True)
+        commands = [(b"command_1", Device(1, 2, "role", "name", 0)), (b"command_2", Device(1, 3, "role", "name", 0))]
+
+        assert client.command_acks(commands) == 0
+        client._library.command_ack_batch.assert_called_once()
+        client._library.command_ack.assert_not_called()
+
+    def test_command_acks_falls_back_to_single_calls(self):
+        client = self._client(batch_supported=False)
+        commands = [(b"command_1", Device(1, 2, "role", "name", 0)), (b"command_2", Device(1, 3, "role", "name", 0))]
+
+        assert client.command_acks(commands) == 0
+        assert client._library.command_ack.call_count == 2
+
+
+class TestExternalServerApiClientDeviceIdentifications:
+    def _client(self) -> ExternalServerApiClient:
+        client = ExternalServerApiClient(MagicMock(), "bringauto", "car_1")
+        client._library = MagicMock()
+        client._library.device_connected.return_value = 0
+        client._library.device_disconnected.return_value = 0
+        client._library.forward_status.return_value = 0
+        return client
+
+    def test_connected_device_identification_is_reused(self):
+        client = self._client()
+        device = Device(1, 2, "role", "name", 0)
+
+        client.device_connected(device)
+        client.forward_status(device, b"status")
+        client.forward_status(device, b"status")
+
+        connected_id = client._library.device_connected.call_args.args[0]
+        first_id = client._library.forward_status.call_args_list[0].args[1]
+        second_id = client._library.forward_status.call_args_list[1].args[1]
+        assert first_id is connected_id
+        assert second_id is connected_id
+
+    def test_not_connected_device_identification_is_not_kept(self):
+        client = self._client()
+        client._library.device_connected.return_value = -1
+        device = Device(1, 2, "role", "name", 0)
+
+        client.device_connected(device)
+
+        assert len(client._device_identifications) == 0
+
+    def test_disconnected_device_identification_is_released(self):
+        client = self._client()
+        device = Device(1, 2, "role", "name", 0)
+
+        client.device_connected(device)
+        client.device_disconnected(0, device)
+
+        assert len(client._device_identifications) == 0
+
+    def test_device_reconnected_with_another_name_replaces_its_identification(self):
+        client = self._client()
+        client.device_connected(Device(1, 2, "role", "name", 0))
+        client.device_disconnected(0, Device(1, 2, "role", "other_name", 0))
+
+        assert len(client._device_identifications) == 0
+
+        client.device_connected(Device(1, 2, "role", "name", 0))
+        client.device_connected(Device(1, 2, "role", "other_name", 0))
+
+        assert len(client._device_identifications) == 1
+
+    def test_clear_device_identifications(self):
+        client = self._client()
+        client.device_connected(Device(1, 2, "role", "name", 0))
+        client.device_connected(Device(1, 3, "role", "name", 0))
+
+        client.clear_device_identifications()
+
+        assert len(client._device_identifications) == 0
+
+
+class TestExternalServerApiClientBufferBytes:
+    def test_buffer_bytes_reads_exactly_size_bytes(self):
+        data = b"route\x00data\x00with\x00zeros"
+        assert ExternalServerApiClient._buffer_bytes(Buffer(data, len(data))) == data
+        assert ExternalServerApiClient._buffer_bytes(Buffer(data, 5)) == b"route"
+
+    def test_buffer_bytes_of_empty_buffer(self):
+        assert ExternalServerApiClient._buffer_bytes(Buffer(ct.c_char_p(), 0)) == bytes()
+        assert ExternalServerApiClient._buffer_bytes(Buffer(b"data", 0)) == bytes()
+
+    def test_buffer_bytes_of_device_identification_member(self):
+        device_id = DeviceIdentification(1, 2, Buffer(b"role", 4), Buffer(b"name\x00", 5), 0)
+        assert ExternalServerApiClient._buffer_bytes(device_id.device_role) == b"role"
+        assert ExternalServerApiClient._buffer_bytes(device_id.device_name) == b"name\x00"
+
+
+class TestExternalServerApiClientCommandCallback:
+    def test_registered_callback_is_called_by_library(self):
+        client = ExternalServerApiClient(MagicMock(), "bringauto", "car_1")
+        client._library = MagicMock()
+        client._library.register_command_callback.return_value = 0
+        callback = MagicMock()
+
+        assert client.register_command_callback(callback) == 0
+        registered_callback = client._library.register_command_callback.call_args.args[0]
+        registered_callback(None)
+        callback.assert_called_once()
+
+    def test_callback_exception_is_not_propagated(self):
+        client = ExternalServerApiClient(MagicMock(), "bringauto", "car_1")
+        client._library = MagicMock()
+        client.register_command_callback(MagicMock(side_effect=RuntimeError()))
+
+        client._library.register_command_callback.call_args.args[0](None)
+
+
+class TestExternalServerApiClientThreadSafety:
+    def _client(self, configured: ThreadSafety | None, declared: int | None) -> ExternalServerApiClient:
+        module_config = MagicMock()
+        module_config.thread_safety = configured
+        client = ExternalServerApiClient(module_config, "bringauto", "car_1")
+        client._library = MagicMock()
+        if declared is None:
+            del client._library.get_thread_safety
+        else:
+            client._library.get_thread_safety.return_value = declared
+        client._set_thread_safety()
+        return client
+
+    def _pop_command_runs_during_forward_status(self, client: ExternalServerApiClient) -> bool:
+        forwarding = threading.Event()
+        release = threading.Event()
+
+        def forward_status(*_args):
+            forwarding.set()
+            release.wait(1)
+            return 0
+
+        client._library.forward_status.side_effect = forward_status
+        client._library.pop_command.return_value = 0
+        client._pop_command_into_supported = False
+        forward_thread = threading.Thread(target=client.forward_status, args=(Device(1, 2, "role", "name", 0), b"s"))
+        forward_thread.start()
+        assert forwarding.wait(1)
+        popped = threading.Event()
+        threading.Thread(target=lambda: (client.pop_command(), popped.set()), daemon=True).start()
+        concurrent = popped.wait(0.3)
+        release.set()
+        forward_thread.join()
+        return concurrent
+
+    def test_module_without_declaration_is_serialized(self):
+        client = self._client(None, None)
+        assert client.thread_safety == ThreadSafety.SERIALIZED
+        assert not self._pop_command_runs_during_forward_status(client)
+
+    def test_declared_split_module_runs_command_path_concurrently(self):
+        client = self._client(None, 1)
+        assert client.thread_safety == ThreadSafety.SPLIT
+        assert self._pop_command_runs_during_forward_status(client)
+
+    def test_config_overrides_declaration(self):
+        client = self._client(ThreadSafety.SERIALIZED, 2)
+        assert client.thread_safety == ThreadSafety.SERIALIZED
+        assert not self._pop_command_runs_during_forward_status(client)
+
+    def test_unknown_declaration_is_serialized(self):
+        assert self._client(None, 7).thread_safety == ThreadSafety.SERIALIZED
+
+    def test_concurrent_module_does_not_lock_status_path(self):
+        client = self._client(ThreadSafety.CONCURRENT, None)
+        client._library.forward_status.return_value = 0
+        with client._status_lock:
+            assert client.forward_status(Device(1, 2, "role", "name", 0), b"s") == 0
+
+
+@pytest.mark.skipif(_fastpath is None, reason="native extension is not built")
+class TestExternalServerApiClientNativeExtension:
+    # Library functions are replaced by ctypes callbacks, which record their arguments
+    ForwardStatus = ct.CFUNCTYPE(ct.c_int, Buffer, DeviceIdentification, ct.c_void_p)
+    ForwardStatusBatch = ct.CFUNCTYPE(
+        ct.c_int, ct.POINTER(Buffer), ct.POINTER(DeviceIdentification), ct.c_size_t, ct.c_void_p
+    )
+
+    def _client(self) -> ExternalServerApiClient:
+        client = ExternalServerApiClient(MagicMock(), "bringauto", "car_1")
+        client._library = MagicMock()
+        client._context = 1234
+        client._forward_status_batch_supported = True
+        return client
+
+    @staticmethod
+    def _status(buffer: Buffer, device: DeviceIdentification) -> tuple:
+        return (
+            ExternalServerApiClient._buffer_bytes(buffer),
+            device.module,
+            device.device_type,
+            ExternalServerApiClient._buffer_bytes(device.device_role),
+            ExternalServerApiClient._buffer_bytes(device.device_name),
+            device.priority,
+        )
+
+    def test_forward_status_passes_structures_to_library(self):
+        client = self._client()
+        forwarded = []
+
+        def forward_status(status, device, context):
+            forwarded.append((self._status(status, device), context))
+            return -1
+
+        callback = self.ForwardStatus(forward_status)
+        client._native_functions = {"forward_status": ct.cast(callback, ct.c_void_p).value}
+
+        assert client.forward_status(Device(1, 2, "rolé", "name", 3), b"st\x00atus") == -1
+        assert forwarded == [((b"st\x00atus", 1, 2, "rolé".encode(), b"name", 3), 1234)]
+        client._library.forward_status.assert_not_called()
+
+    def test_forward_statuses_passes_batch_to_library(self):
+        client = self._client()
+        forwarded = []
+
+        def forward_status_batch(statuses, devices, count, context):
+            forwarded.extend(self._status(statuses[i], devices[i]) for i in range(count))
+            return 0
+
+        callback = self.ForwardStatusBatch(forward_status_batch)
+        client._native_functions = {"forward_status_batch": ct.cast(callback, ct.c_void_p).value}
+        statuses = [(Device(1, 2, "role", f"name_{i}", 0), f"status_{i}".encode()) for i in range(3)]
+
+        assert client.forward_statuses(statuses) == 0
+        assert forwarded == [(f"status_{i}".encode(), 1, 2, b"role", f"name_{i}".encode(), 0) for i in range(3)]
+        client._library.forward_status_batch.assert_not_called()
+
+    def test_invalid_status_raises(self):
+        client = self._client()
+        callback = self.ForwardStatusBatch(lambda *_args: 0)
+        client._native_functions = {"forward_status_batch": ct.cast(callback, ct.c_void_p).value}
+
+        with pytest.raises(TypeError):
+            client.forward_statuses([(Device(1, 2, "role", "name", 0), "status"), (Device(1, 2, 3, "name", 0), b"s")])
@@ -0,0 +1,54 @@
+import json
+import logging
+import queue
+
+from external_server.logs import COMMAND_LOG, STATUS_LOG, JsonFormatter, LazyQueueHandler, SamplingFilter
+
+
+def _record(message: str, *args, level: int = logging.INFO, extra: dict | None = None) -> logging.LogRecord:
+    record = logging.LogRecord("Test", level, __file__, 1, message, args, None)
+    for key, value in (extra or {}).items():
+        setattr(record, key, value)
+    return record
+
+
+class TestSamplingFilter:
+    def test_every_nth_record_of_category_passes(self):
+        sampling_filter = SamplingFilter({"status": 3})
+        passed = [sampling_filter.filter(_record("status", extra=STATUS_LOG)) for _ in range(7)]
+        assert passed == [True, False, False, True, False, False, True]
+
+    def test_categories_are_sampled_separately(self):
+        sampling_filter = SamplingFilter({"status": 2, "command": 2})
+        assert sampling_filter.filter(_record("status", extra=STATUS_LOG))
+        assert sampling_filter.filter(_record("command", extra=COMMAND_LOG))
+        assert not sampling_filter.filter(_record("status", extra=STATUS_LOG))
+
+    def test_records_without_category_and_warnings_always_pass(self):
+        sampling_filter = SamplingFilter({"status": 100})
+        sampling_filter.filter(_record("status", extra=STATUS_LOG))
+        assert all(sampling_filter.filter(_record("other")) for _ in range(3))
+        assert all(sampling_filter.filter(_record("status", level=logging.WARNING, extra=STATUS_LOG)) for _ in range(3))
+
+
+class TestJsonFormatter:
+    def test_record_is_formatted_as_single_line_json(self):
+        line = JsonFormatter().format(_record("Received Status message, messageCounter: %d", 5, extra=STATUS_LOG))
+        assert "\n" not in line
+        entry = json.loads(line)
+        assert entry["message"] == "Received Status message, messageCounter: 5"
+        assert entry["level"] == "INFO"
+        assert entry["logger"] == "Test"
+        assert entry["category"] == "status"
+
+
+class TestLazyQueueHandler:
+    def test_record_is_enqueued_unformatted(self):
+        log_queue = queue.SimpleQueue()
+        handler = LazyQueueHandler(log_queue)
+        record = _record("counter: %d", 7)
+        handler.handle(record)
+        queued = log_queue.get_nowait()
+        assert queued is record
+        assert queued.args == (7,)
+        assert queued.getMessage() == "counter: 7"
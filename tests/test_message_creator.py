@@ -0,0 +1,32 @@
+import sys
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+from external_server.message_creator import MessageCreator, StatusResponseSerializer
+
+
+class TestStatusResponseSerializer:
+    def test_serialized_response_is_same_as_serialized_message(self):
+        serializer = StatusResponseSerializer()
+        for session_id, message_counter in [("session", 1), ("session", 300), ("other_session", 0), ("", 5)]:
+            expected = MessageCreator.create_status_response(session_id, message_counter).SerializeToString()
+            assert serializer.serialize(session_id, message_counter) == expected
+
+    def test_serialized_response_can_be_parsed(self):
+        payload = StatusResponseSerializer().serialize("session", 2**32 - 1)
+
+        message = external_protocol.ExternalServer.FromString(payload)
+        assert message.HasField("statusResponse")
+        assert message.statusResponse.sessionId == "session"
+        assert message.statusResponse.messageCounter == 2**32 - 1
+
+
+class TestMessageCreator:
+    def test_external_command_without_device_and_data(self):
+        message = MessageCreator.create_external_command("session", 3, None, None)
+
+        assert message.command.sessionId == "session"
+        assert message.command.messageCounter == 3
+        assert message.command.deviceCommand.HasField("device")
+        assert message.command.deviceCommand.commandData == b""
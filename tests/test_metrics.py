@@ -0,0 +1,99 @@
+import urllib.error
+import urllib.request
+
+import pytest
+
+from external_server.metrics import Histogram, MetricsRegistry, MetricsServer
+
+
+class TestHistogram:
+    def test_empty_histogram(self):
+        histogram = Histogram()
+
+        assert histogram.count == 0
+        assert histogram.quantile(0.5) == 0.0
+
+    def test_quantile_has_bounded_relative_error(self):
+        histogram = Histogram()
+        for value in range(1, 1001):
+            histogram.observe(value / 1000)
+
+        median = histogram.quantile(0.5)
+        assert 0.5 <= median <= 0.5 * 2 ** (1 / Histogram.SUB_BUCKETS)
+        assert histogram.count == 1000
+        assert abs(histogram.sum - 500.5) < 1e-6
+
+    def test_values_out_of_range_are_counted(self):
+        histogram = Histogram()
+        histogram.observe(0)
+        histogram.observe(Histogram.MAX_VALUE * 4)
+
+        buckets = histogram.buckets()
+        assert buckets[0] == (Histogram.BOUNDS[0], 1)
+        assert buckets[-1] == (float("inf"), 2)
+        assert histogram.quantile(1) == float("inf")
+
+
+class TestMetricsRegistry:
+    def test_same_labels_return_same_metric(self):
+        registry = MetricsRegistry()
+
+        counter = registry.counter("test_same_total", "help", car="car")
+        assert registry.counter("test_same_total", "help", car="car") is counter
+        assert registry.counter("test_same_total", "help", car="other") is not counter
+
+    def test_render_contains_all_metric_types(self):
+        registry = MetricsRegistry()
+        registry.counter("test_render_total", "Counter help", car="car").inc(3)
+        registry.histogram("test_render_seconds", "Histogram help", module="2").observe(0.001)
+        registry.gauge("test_render_depth", "Gauge help", lambda: 7, car="car")
+
+        text = registry.render()
+        assert "# HELP test_render_total Counter help\n# TYPE test_render_total counter" in text
+        assert 'test_render_total{car="car"} 3' in text
+        assert "# TYPE test_render_seconds histogram" in text
+        assert 'test_render_seconds_bucket{module="2",le="+Inf"} 1' in text
+        assert 'test_render_seconds_count{module="2"} 1' in text
+        assert 'test_render_depth{car="car"} 7' in text
+
+    def test_removed_gauge_is_not_rendered(self):
+        registry = MetricsRegistry()
+        registry.gauge("test_removed_depth", "help", lambda: 1, car="car")
+        registry.remove_gauge("test_removed_depth", car="car")
+
+        assert 'test_removed_depth{car="car"}' not in registry.render()
+
+
+class TestMetricsServer:
+    def test_metrics_are_served(self):
+        MetricsRegistry().counter("test_served_total", "help").inc()
+        server = MetricsServer(0)
+        server.start()
+        try:
+            port = server._server.server_address[1]
+            with urllib.request.urlopen(f"http://127.0.0.1:{port}/metrics") as response:
+                body = response.read().decode("utf-8")
+        finally:
+            server.stop()
+
+        assert "test_served_total 1" in body
+
+    def test_readiness_is_served(self):
+        ready = [False]
+        MetricsRegistry().readiness_check("test_component", lambda: ready[0])
+        server = MetricsServer(0)
+        server.start()
+        try:
+            port = server._server.server_address[1]
+            with urllib.request.urlopen(f"http://127.0.0.1:{port}/health") as response:
+                assert response.status == 200
+            with pytest.raises(urllib.error.HTTPError) as error:
+                urllib.request.urlopen(f"http://127.0.0.1:{port}/ready")
+            assert error.value.code == 503
+            ready[0] = True
+            with urllib.request.urlopen(f"http://127.0.0.1:{port}/ready") as response:
+                assert response.status == 200
+                assert "test_component: ready" in response.read().decode("utf-8")
+        finally:
+            server.stop()
+            MetricsRegistry().remove_readiness_check("test_component")
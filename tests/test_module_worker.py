@@ -0,0 +1,109 @@
+import threading
+import time
+
+from external_server.module_worker import ModuleWorker
+from external_server.structures import Backpressure
+
+
+def _blocked_worker(queue_size: int, backpressure: Backpressure) -> tuple[ModuleWorker, threading.Event]:
+    """Returns started worker, which thread is blocked in a call until the returned event is set."""
+    worker = ModuleWorker(1, queue_size, backpressure)
+    worker.start()
+    release = threading.Event()
+    started = threading.Event()
+
+    def blocking_call():
+        started.set()
+        release.wait(5)
+
+    worker.submit(blocking_call)
+    assert started.wait(5)
+    return worker, release
+
+
+class TestModuleWorker:
+    def test_calls_are_made_in_order_by_worker_thread(self):
+        worker = ModuleWorker(1)
+        worker.start()
+        calls = []
+        for i in range(10):
+            worker.submit(lambda i=i: calls.append((i, threading.current_thread().name)), droppable=i % 2 == 0)
+        worker.drain()
+        worker.stop()
+        assert [i for i, _ in calls] == list(range(10))
+        assert all(name == "Module1" for _, name in calls)
+
+    def test_call_returns_result(self):
+        worker = ModuleWorker(1)
+        worker.start()
+        assert worker.call(lambda a, b: a + b, 1, 2) == 3
+        worker.stop()
+
+    def test_calls_are_made_directly_before_start(self):
+        worker = ModuleWorker(1)
+        assert worker.call(threading.current_thread) is threading.current_thread()
+
+    def test_slow_module_does_not_block_other_module(self):
+        slow, release = _blocked_worker(10, Backpressure.BLOCK)
+        fast = ModuleWorker(2)
+        fast.start()
+        start = time.monotonic()
+        slow.submit(lambda: None, droppable=True)
+        assert fast.call(lambda: 2) == 2
+        assert time.monotonic() - start < 1
+        release.set()
+        slow.stop()
+        fast.stop()
+
+    def test_block_waits_for_free_space(self):
+        worker, release = _blocked_worker(1, Backpressure.BLOCK)
+        worker.submit(lambda: None, droppable=True)
+        threading.Timer(0.2, release.set).start()
+        start = time.monotonic()
+        future = worker.submit(lambda: "last", droppable=True)
+        assert time.monotonic() - start >= 0.15
+        assert future.result(5) == "last"
+        worker.stop()
+
+    def test_drop_oldest_discards_oldest_status_batch(self):
+        worker, release = _blocked_worker(2, Backpressure.DROP_OLDEST)
+        control = worker.submit(lambda: "control")
+        oldest = worker.submit(lambda: "oldest", droppable=True)
+        newest = worker.submit(lambda: "newest", droppable=True)
+        assert oldest.cancelled()
+        assert len(worker) == 2
+        release.set()
+        assert control.result(5) == "control"
+        assert newest.result(5) == "newest"
+        worker.stop()
+
+    def test_drop_oldest_queues_other_calls_over_limit(self):
+        worker, release = _blocked_worker(2, Backpressure.DROP_OLDEST)
+        batch = worker.submit(lambda: "batch", droppable=True)
+        controls = [worker.submit(lambda i=i: i) for i in range(3)]
+        # Queue is full of calls, which are not status batches, and nothing is discarded
+        assert not batch.cancelled()
+        assert len(worker) == 4
+        release.set()
+        assert batch.result(5) == "batch"
+        assert [control.result(5) for control in controls] == [0, 1, 2]
+        worker.stop()
+
+    def test_disconnect_rejects_status_batch_when_full(self):
+        worker, release = _blocked_worker(1, Backpressure.DISCONNECT)
+        queued = worker.submit(lambda: "queued", droppable=True)
+        assert worker.submit(lambda: "rejected", droppable=True) is None
+        # Calls, which are not status batches, are queued over the limit
+        control = worker.submit(lambda: "control")
+        assert worker.drop_statuses() == 1
+        assert queued.cancelled()
+        release.set()
+        assert control.result(5) == "control"
+        worker.stop()
+
+    def test_stop_makes_queued_calls(self):
+        worker, release = _blocked_worker(10, Backpressure.BLOCK)
+        futures = [worker.submit(lambda i=i: i) for i in range(3)]
+        release.set()
+        worker.stop()
+        assert [future.result(0) for future in futures] == [0, 1, 2]
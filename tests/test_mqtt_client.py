@@ -2,9 +2,15 @@ import pytest
 from unittest.mock import MagicMock
 import sys
 
+import paho.mqtt.client as mqtt
+
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
-from external_server.mqtt_client import MqttClient
+from external_server.codec import Compression, PayloadCodec
+from external_server.mqtt_client import MqttClient, MultiCarMqttClient, CarMqttClient
+from external_server.event_queue import EventQueue, EventType
+from external_server.structures import EventPriority
+import external_server.constants as constants
 import ExternalProtocol_pb2 as external_protocol
 
 
@@ -69,3 +75,241 @@ def test_stop(mqtt_client):
 
     mqtt_client.mqtt_client.loop_stop.assert_called_once()
     assert mqtt_client.is_connected is False
+
+
+@pytest.fixture
+def multi_car_mqtt_client():
+    def on_new_car(car_name):
+        return CarMqttClient(client, "company_name", car_name, EventQueue())
+
+    client = MultiCarMqttClient("company_name", on_new_car)
+    return client
+
+
+def _receive(client, topic, session_id):
+    received_msg = external_protocol.ExternalClient()
+    received_msg.connect.sessionId = session_id
+    message = MagicMock()
+    message.topic = topic
+    message.payload = received_msg.SerializeToString()
+    client._on_message(None, None, message)
+
+
+def test_multi_car_routes_messages_by_car_name(multi_car_mqtt_client):
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_1")
+    _receive(multi_car_mqtt_client, "company_name/car_2/module_gateway", "session_2")
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_3")
+
+    car_1 = multi_car_mqtt_client._car_clients["car_1"]
+    car_2 = multi_car_mqtt_client._car_clients["car_2"]
+    assert len(multi_car_mqtt_client._car_clients) == 2
+    assert car_1.get(timeout=0).connect.sessionId == "session_1"
+    assert car_1.get(timeout=0).connect.sessionId == "session_3"
+    assert car_1.get(timeout=0) is None
+    assert car_2._event_queue.qsize() == 1
+    assert car_2.get(timeout=0).connect.sessionId == "session_2"
+    assert car_2._event_queue.qsize() == 0
+
+
+def test_multi_car_ignores_other_topics_and_invalid_car_names(multi_car_mqtt_client):
+    _receive(multi_car_mqtt_client, "other_company/car_1/module_gateway", "session_1")
+    _receive(multi_car_mqtt_client, "company_name/car_1/external_server", "session_1")
+    _receive(multi_car_mqtt_client, "company_name/Car-1/module_gateway", "session_1")
+
+    assert len(multi_car_mqtt_client._car_clients) == 0
+
+
+def test_multi_car_disconnect_is_announced_to_all_cars(multi_car_mqtt_client):
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_1")
+    car_1 = multi_car_mqtt_client._car_clients["car_1"]
+    car_1.get(timeout=0)
+    car_1._event_queue.clear()
+
+    multi_car_mqtt_client._on_disconnect(None, None, 0)
+
+    assert car_1._event_queue.get(block=False).event == EventType.MQTT_BROKER_DISCONNECTED
+    multi_car_mqtt_client._on_disconnect(None, None, 0)
+    assert car_1.get(timeout=0) is False
+    assert multi_car_mqtt_client.is_connected is False
+
+
+def test_multi_car_removed_car_is_created_again_by_next_message(multi_car_mqtt_client):
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_1")
+    car_1 = multi_car_mqtt_client._car_clients["car_1"]
+    car_1.set_device_count(2)
+
+    multi_car_mqtt_client.remove_car("car_1", car_1)
+
+    assert len(multi_car_mqtt_client._car_clients) == 0
+    assert len(multi_car_mqtt_client._car_device_counts) == 0
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_2")
+    assert multi_car_mqtt_client._car_clients["car_1"] is not car_1
+    multi_car_mqtt_client.remove_car("car_1", car_1)
+    assert multi_car_mqtt_client._car_clients["car_1"].get(timeout=0).connect.sessionId == "session_2"
+
+
+def test_car_mqtt_client_publishes_to_car_topic(multi_car_mqtt_client):
+    multi_car_mqtt_client._mqtt_client.publish = MagicMock()
+    car_client = CarMqttClient(multi_car_mqtt_client, "company_name", "car_1", EventQueue())
+
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.connectResponse.sessionId = "session_id"
+    car_client.publish(sent_msg)
+
+    multi_car_mqtt_client._mqtt_client.publish.assert_called_once_with(
+        "company_name/car_1/external_server", sent_msg.SerializeToString(), qos=1
+    )
+
+
+def _publish_with_rc(client, rc):
+    client._mqtt_client.publish = MagicMock(return_value=MagicMock(rc=rc))
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.statusResponse.sessionId = "session_id"
+    client.publish(sent_msg)
+
+
+def test_dropped_messages_are_counted():
+    client = MqttClient("company_name", "car_name", max_queued_messages=1)
+    _publish_with_rc(client, mqtt.MQTT_ERR_SUCCESS)
+    _publish_with_rc(client, mqtt.MQTT_ERR_SUCCESS)
+
+    client._mqtt_client.publish.assert_not_called()
+    assert client.dropped_messages == 1
+    assert client.queued_messages == 1
+
+
+def test_high_priority_message_is_queued_over_limit():
+    client = MqttClient("company_name", "car_name", max_queued_messages=1)
+    _publish_with_rc(client, mqtt.MQTT_ERR_SUCCESS)
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.command.sessionId = "session_id"
+    client.publish(sent_msg, EventPriority.HIGH)
+
+    assert client._mqtt_client.publish.call_count == 2
+    assert client.dropped_messages == 0
+    assert client.queued_messages == 2
+
+
+def test_high_priority_message_does_not_lift_limit_of_other_cars(multi_car_mqtt_client):
+    multi_car_mqtt_client._queued_messages_limit = 1
+    multi_car_mqtt_client._mqtt_client.publish = MagicMock(return_value=MagicMock(rc=mqtt.MQTT_ERR_SUCCESS))
+    car_1 = CarMqttClient(multi_car_mqtt_client, "company_name", "car_1", EventQueue())
+    car_2 = CarMqttClient(multi_car_mqtt_client, "company_name", "car_2", EventQueue())
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.command.sessionId = "session_id"
+
+    car_1.publish(sent_msg, EventPriority.HIGH)
+    car_1.publish(sent_msg, EventPriority.HIGH)
+    car_2.publish(sent_msg)
+
+    assert multi_car_mqtt_client._mqtt_client.publish.call_count == 2
+    assert multi_car_mqtt_client.dropped_messages == 1
+
+
+def test_queue_high_water_mark(mqtt_client):
+    for _ in range(3):
+        _publish_with_rc(mqtt_client, mqtt.MQTT_ERR_SUCCESS)
+    for mid in range(3):
+        mqtt_client._on_publish(None, None, mid)
+    _publish_with_rc(mqtt_client, mqtt.MQTT_ERR_SUCCESS)
+
+    assert mqtt_client.queued_messages == 1
+    assert mqtt_client.queued_messages_high_water_mark == 3
+    assert mqtt_client.dropped_messages == 0
+
+
+def test_queue_size_is_not_adapted_by_default(mqtt_client):
+    mqtt_client._mqtt_client.max_inflight_messages_set = MagicMock()
+    mqtt_client.set_device_count(100)
+
+    assert mqtt_client._queued_messages_limit == constants.MAX_QUEUED_MESSAGES
+    mqtt_client._mqtt_client.max_inflight_messages_set.assert_not_called()
+
+
+def test_adaptive_queue_grows_with_device_count():
+    client = MqttClient("company_name", "car_name", max_queued_messages=20, max_inflight_messages=10, adaptive_queue=True)
+    client._mqtt_client.max_inflight_messages_set = MagicMock()
+
+    client.set_device_count(2)
+    assert client._queued_messages_limit == 20
+    client._mqtt_client.max_inflight_messages_set.assert_called_with(10)
+
+    client.set_device_count(100)
+    assert client._queued_messages_limit == 100 * constants.QUEUED_MESSAGES_PER_DEVICE
+    client._mqtt_client.max_inflight_messages_set.assert_called_with(100 * constants.INFLIGHT_MESSAGES_PER_DEVICE)
+
+
+def test_multi_car_adaptive_queue_counts_devices_of_all_cars():
+    client = MultiCarMqttClient("company_name", lambda _: None, max_queued_messages=1, adaptive_queue=True)
+    car_1 = CarMqttClient(client, "company_name", "car_1", EventQueue())
+    car_2 = CarMqttClient(client, "company_name", "car_2", EventQueue())
+
+    car_1.set_device_count(3)
+    car_2.set_device_count(5)
+
+    assert client._queued_messages_limit == 8 * constants.QUEUED_MESSAGES_PER_DEVICE
+
+
+def test_get_returns_message_carried_by_event_and_drops_other_events(multi_car_mqtt_client):
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_1")
+    car_1 = multi_car_mqtt_client._car_clients["car_1"]
+    car_1._event_queue.add_event(EventType.COMMAND_AVAILABLE, 1)
+    _receive(multi_car_mqtt_client, "company_name/car_1/module_gateway", "session_2")
+
+    assert car_1.get(timeout=0).connect.sessionId == "session_1"
+    assert car_1.get(timeout=0).connect.sessionId == "session_2"
+    assert car_1._event_queue.qsize() == 0
+    assert car_1.last_received_at > 0
+
+
+def test_compressed_connect_negotiates_compression_of_published_messages():
+    client = MultiCarMqttClient("company_name", lambda car_name: car_client, codec=PayloadCodec(enabled=True))
+    car_client = CarMqttClient(client, "company_name", "car_1", EventQueue())
+    client._mqtt_client.publish = MagicMock()
+    connect_msg = external_protocol.ExternalClient()
+    connect_msg.connect.sessionId = "session_id" * 20
+    message = MagicMock()
+    message.topic = "company_name/car_1/module_gateway"
+    message.payload = client.codec.encode(connect_msg.SerializeToString(), Compression.ZLIB)
+
+    client._on_message(None, None, message)
+    assert car_client.get(timeout=0).connect.sessionId == connect_msg.connect.sessionId
+    car_client.accept_compression()
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.connectResponse.sessionId = "session_id" * 20
+    car_client.publish(sent_msg)
+
+    payload = client._mqtt_client.publish.call_args[0][1]
+    assert client.codec.decode(payload) == (sent_msg.SerializeToString(), Compression.ZLIB)
+
+
+def test_compression_of_not_accepted_connect_is_not_used():
+    client = MultiCarMqttClient("company_name", lambda car_name: car_client, codec=PayloadCodec(enabled=True))
+    car_client = CarMqttClient(client, "company_name", "car_1", EventQueue())
+    client._mqtt_client.publish = MagicMock()
+    connect_msg = external_protocol.ExternalClient()
+    connect_msg.connect.sessionId = "session_id" * 20
+    message = MagicMock()
+    message.topic = "company_name/car_1/module_gateway"
+    message.payload = client.codec.encode(connect_msg.SerializeToString(), Compression.ZLIB)
+
+    client._on_message(None, None, message)
+    assert car_client.get(timeout=0).connect.sessionId == connect_msg.connect.sessionId
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.connectResponse.sessionId = "session_id" * 20
+    car_client.publish(sent_msg)
+
+    payload = client._mqtt_client.publish.call_args[0][1]
+    assert payload == sent_msg.SerializeToString()
+
+
+def test_plain_connect_keeps_published_messages_plain(mqtt_client):
+    mqtt_client._codec = PayloadCodec(enabled=True)
+    mqtt_client._mqtt_client.publish = MagicMock()
+    _receive(mqtt_client, mqtt_client._subscribe_topic, "session_id" * 20)
+
+    sent_msg = external_protocol.ExternalServer()
+    sent_msg.connectResponse.sessionId = "session_id" * 20
+    mqtt_client.publish(sent_msg)
+
+    assert mqtt_client._mqtt_client.publish.call_args[0][1] == sent_msg.SerializeToString()
@@ -5,6 +5,8 @@ import sys
 sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
 
 from external_server.checker.order_checker import OrderChecker
+from external_server.event_queue import EventQueue, EventType
+from external_server.structures import TimeoutType
 import ExternalProtocol_pb2 as external_protocol
 
 TIMEOUT = 1
@@ -211,3 +213,63 @@ def test_wait_for_timeout_after_reset(order_checker):
     time.sleep(SLEEP_TIME)
 
     order_checker.check_time_out()
+
+
+class TestOrderCheckerReorderBuffer:
+    TIMEOUT = 0.2
+    SLEEP_TIME = TIMEOUT + 0.2
+
+    @staticmethod
+    def _checker(window_size: int = OrderChecker.WINDOW_SIZE):
+        event_queue = EventQueue()
+        return OrderChecker(TestOrderCheckerReorderBuffer.TIMEOUT, event_queue, window_size=window_size), event_queue
+
+    def test_large_gap_uses_single_deadline(self):
+        checker, _ = self._checker()
+        checker.check(external_protocol.Status(messageCounter=1000))
+
+        assert checker._deadline is not None
+        assert len(checker._gaps) == 1
+        assert checker.get_status() is None
+        checker.reset()
+
+    def test_deadline_moves_to_next_missing_status(self):
+        checker, _ = self._checker()
+        checker.check(external_protocol.Status(messageCounter=3))
+        first_deadline = checker._deadline
+        checker.check(external_protocol.Status(messageCounter=1))
+
+        assert first_deadline.cancelled
+        assert checker._deadline_counter == 2
+        checker.check(external_protocol.Status(messageCounter=2))
+
+        assert checker._deadline is None
+        assert [checker.get_status().messageCounter for _ in range(3)] == [1, 2, 3]
+        assert checker.get_status() is None
+
+    def test_duplicate_status_is_ignored(self):
+        checker, _ = self._checker()
+        checker.check(external_protocol.Status(messageCounter=1))
+        checker.check(external_protocol.Status(messageCounter=1))
+        checker.check(external_protocol.Status(messageCounter=3))
+        checker.check(external_protocol.Status(messageCounter=3))
+
+        assert checker.get_status().messageCounter == 1
+        assert checker.get_status() is None
+        checker.reset()
+
+    def test_missing_status_times_out(self):
+        checker, event_queue = self._checker()
+        checker.check(external_protocol.Status(messageCounter=2))
+
+        event = event_queue.get(timeout=self.SLEEP_TIME)
+        assert event.event == EventType.TIMEOUT_OCCURRED
+        assert event.data == TimeoutType.MESSAGE_TIMEOUT
+        checker.reset()
+
+    def test_status_beyond_window_times_out_immediately(self):
+        checker, event_queue = self._checker(window_size=8)
+        checker.check(external_protocol.Status(messageCounter=9))
+
+        assert event_queue.get(timeout=0.1).data == TimeoutType.MESSAGE_TIMEOUT
+        assert checker._deadline is None
@@ -0,0 +1,80 @@
+import sys
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import InternalProtocol_pb2 as internal_protocol
+from external_server.status_filter import StatusFilter, StatusFilterSettings
+
+
+def _device(module: int, role: str) -> internal_protocol.Device:
+    return internal_protocol.Device(module=module, deviceType=0, deviceRole=role, deviceName=role)
+
+
+class TestStatusFilter:
+    def test_modules_without_settings_are_not_filtered(self):
+        status_filter = StatusFilter({1: StatusFilterSettings()})
+        assert not status_filter.enabled
+        assert status_filter.forward(_device(1, "a"), b"data", 0)
+        assert status_filter.forward(_device(1, "a"), b"data", 0)
+        assert status_filter.forward(_device(2, "a"), b"data", 0)
+
+    def test_duplicate_status_is_skipped(self):
+        status_filter = StatusFilter({1: StatusFilterSettings(deduplicate=True)})
+        device = _device(1, "a")
+        assert status_filter.forward(device, b"pressed", 0)
+        assert not status_filter.forward(device, b"pressed", 1)
+        assert status_filter.forward(_device(1, "b"), b"pressed", 1)
+        assert status_filter.forward(device, b"released", 2)
+        assert status_filter.forward(device, b"pressed", 3)
+
+    def test_status_within_interval_is_held_and_replaced(self):
+        status_filter = StatusFilter({1: StatusFilterSettings(min_interval=1)})
+        device = _device(1, "a")
+        assert status_filter.forward(device, b"1", 0)
+        assert not status_filter.forward(device, b"2", 0.2)
+        assert not status_filter.forward(device, b"3", 0.5)
+        assert status_filter.next_due() == 1
+        assert status_filter.take_due(0.9) == []
+        assert status_filter.take_due(1) == [(device, b"3")]
+        assert status_filter.next_due() is None
+        assert not status_filter.forward(device, b"4", 1.5)
+
+    def test_status_after_interval_replaces_held_status(self):
+        status_filter = StatusFilter({1: StatusFilterSettings(min_interval=1)})
+        device = _device(1, "a")
+        status_filter.forward(device, b"1", 0)
+        status_filter.forward(device, b"2", 0.5)
+        assert status_filter.forward(device, b"3", 1.2)
+        assert status_filter.take_due(2) == []
+
+    def test_duplicate_of_held_status_is_skipped(self):
+        status_filter = StatusFilter({1: StatusFilterSettings(deduplicate=True, min_interval=1)})
+        device = _device(1, "a")
+        status_filter.forward(device, b"1", 0)
+        status_filter.forward(device, b"2", 0.5)
+        # Module gets 2 once the interval elapses, repeated 2 brings no new state
+        assert not status_filter.forward(device, b"2", 0.7)
+        assert status_filter.take_due(1) == [(device, b"2")]
+        assert not status_filter.forward(device, b"2", 3)
+
+    def test_removed_device_is_forgotten(self):
+        status_filter = StatusFilter({1: StatusFilterSettings(deduplicate=True, min_interval=1)})
+        device = _device(1, "a")
+        status_filter.forward(device, b"1", 0)
+        status_filter.forward(device, b"2", 0.5)
+        status_filter.remove(device)
+        assert status_filter.next_due() is None
+        assert status_filter.forward(device, b"2", 0.6)
+
+    def test_module_settings_can_be_replaced(self):
+        status_filter = StatusFilter({1: StatusFilterSettings(deduplicate=True, min_interval=1)})
+        device = _device(1, "a")
+        status_filter.forward(device, b"1", 0)
+        status_filter.forward(device, b"2", 0.5)
+        status_filter.set_module(1, StatusFilterSettings(deduplicate=True))
+        assert status_filter.next_due() is None
+        assert status_filter.forward(device, b"2", 0.6)
+        assert not status_filter.forward(device, b"2", 0.7)
+        status_filter.set_module(1, None)
+        assert not status_filter.enabled
+        assert status_filter.forward(device, b"2", 0.8)
@@ -0,0 +1,122 @@
+import socket
+import struct
+import sys
+
+sys.path.append("lib/fleet-protocol/protobuf/compiled/python")
+
+import ExternalProtocol_pb2 as external_protocol
+import external_server.constants as constants
+from external_server.event_queue import EventQueue
+from external_server.unix_socket_client import UnixSocketClient
+
+
+def _connect_message(session_id: str) -> bytes:
+    msg = external_protocol.ExternalClient()
+    msg.connect.sessionId = session_id
+    return msg.SerializeToString()
+
+
+def _frame(payload: bytes) -> bytes:
+    return struct.pack("<I", len(payload)) + payload
+
+
+def _read_frame(gateway: socket.socket) -> bytes:
+    header = gateway.recv(4, socket.MSG_WAITALL)
+    (length,) = struct.unpack("<I", header)
+    return gateway.recv(length, socket.MSG_WAITALL)
+
+
+def _gateway(path) -> socket.socket:
+    gateway = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    gateway.settimeout(1)
+    gateway.connect(str(path))
+    return gateway
+
+
+class TestUnixSocketClient:
+    def _client(self, tmp_path) -> UnixSocketClient:
+        client = UnixSocketClient(tmp_path / "external_server.sock", EventQueue())
+        client.init()
+        client.connect("", 0)
+        client.start()
+        return client
+
+    def test_messages_are_received_across_writes(self, tmp_path):
+        client = self._client(tmp_path)
+        try:
+            gateway = _gateway(tmp_path / "external_server.sock")
+            data = _frame(_connect_message("session_1")) + _frame(_connect_message("session_2"))
+            gateway.sendall(data[:3])
+            assert client.get(timeout=0.1) is None
+            gateway.sendall(data[3:])
+            assert client.get(timeout=1).connect.sessionId == "session_1"
+            assert client.get(timeout=1).connect.sessionId == "session_2"
+            assert client.last_received_at > 0
+        finally:
+            client.stop()
+
+    def test_published_message_is_framed(self, tmp_path):
+        client = self._client(tmp_path)
+        try:
+            gateway = _gateway(tmp_path / "external_server.sock")
+            gateway.sendall(_frame(_connect_message("session")))
+            client.get(timeout=1)
+            msg = external_protocol.ExternalServer()
+            msg.connectResponse.sessionId = "session"
+            client.publish(msg)
+
+            received = external_protocol.ExternalServer.FromString(_read_frame(gateway))
+            assert received.connectResponse.sessionId == "session"
+            assert client.dropped_messages == 0
+        finally:
+            client.stop()
+
+    def test_message_without_gateway_is_dropped(self, tmp_path):
+        client = self._client(tmp_path)
+        try:
+            client.publish_serialized(b"message")
+            assert client.dropped_messages == 1
+        finally:
+            client.stop()
+
+    def test_new_connection_replaces_previous(self, tmp_path):
+        client = self._client(tmp_path)
+        try:
+            first = _gateway(tmp_path / "external_server.sock")
+            first.sendall(_frame(_connect_message("first")))
+            client.get(timeout=1)
+            second = _gateway(tmp_path / "external_server.sock")
+            second.sendall(_frame(_connect_message("second")))
+            assert client.get(timeout=1).connect.sessionId == "second"
+
+            assert first.recv(1) == b""
+            client.publish_serialized(b"message")
+            assert _read_frame(second) == b"message"
+        finally:
+            client.stop()
+
+    def test_too_large_message_closes_connection(self, tmp_path):
+        client = self._client(tmp_path)
+        try:
+            gateway = _gateway(tmp_path / "external_server.sock")
+            gateway.sendall(struct.pack("<I", constants.UNIX_SOCKET_MAX_MESSAGE_SIZE + 1))
+            assert gateway.recv(1) == b""
+            assert client.get(timeout=0.1) is None
+        finally:
+            client.stop()
+
+    def test_stop_removes_socket_and_socket_left_by_previous_run_is_replaced(self, tmp_path):
+        path = tmp_path / "external_server.sock"
+        left = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        left.bind(str(path))
+        left.close()
+
+        client = self._client(tmp_path)
+        assert client.is_connected
+        client.stop()
+        assert not client.is_connected
+        assert not path.exists()
+        client.connect("", 0)
+        client.start()
+        _gateway(path).close()
+        client.stop()